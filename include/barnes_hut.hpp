@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../include/particle.hpp"
+#include "../utils/thread_pool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct QuadNode {
+    glm::vec2 center_of_mass;
+    float mass;
+
+    glm::vec2 center;
+    float half_size;
+
+    int children[4]; // -1 for missing children, all -1 on leaves
+    int first;       // Range of particle indices in `order` covered by this node
+    int count;
+};
+
+// Barnes-Hut quadtree for long-range pairwise forces. The tree is rebuilt
+// every step into arenas that keep their capacity between steps: the sixteen
+// depth-2 subtrees are built in parallel and then spliced into one flat array.
+class BarnesHut {
+public:
+    float theta = 0.5f;       // Opening angle, smaller is more accurate
+    float strength = 0.0001f; // Positive attracts (gravity), negative repels (like charges)
+    float softening = 2.0f;
+    int leaf_size = 8;
+
+    void build(const ParticleVector &particles, ThreadPool &threader);
+    void accumulate(ParticleVector &particles, ThreadPool &threader) const;
+
+    std::vector<QuadNode> nodes;
+
+private:
+    static const int max_depth = 32;
+    static const int num_subtrees = 16;
+
+    std::vector<int> order;
+    std::vector<QuadNode> subtreeArenas[num_subtrees];
+    int subtreeFirst[num_subtrees];
+    int subtreeCount[num_subtrees];
+
+    int buildNode(std::vector<QuadNode> &arena, const ParticleVector &particles, int first, int count, glm::vec2 center, float half_size, int depth);
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../include/particle.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct Segment {
+    glm::vec2 a;
+    glm::vec2 b;
+};
+
+// Static line geometry binned into the simulation grid. Each cell stores the
+// segments that come within `margin` of it, so a particle only has to test the
+// segments listed for the cell containing its center.
+class ColliderSet {
+public:
+    void addSegment(glm::vec2 a, glm::vec2 b);
+    void addPolygon(const std::vector<glm::vec2> &points, bool closed = true);
+    void clear();
+
+    void build(int grid_width, int grid_height, int cell_size, float margin);
+    void collide(Particle &p, float dampening) const;
+
+    bool empty() const { return segments.empty(); }
+
+    bool dirty = true;
+
+    std::vector<Segment> segments;
+
+    std::vector<int> cellOffsets;
+    std::vector<int> cellIndices;
+
+private:
+    int grid_width = 0;
+    int grid_height = 0;
+    int cell_size = 1;
+
+    template <class F>
+    void forEachOverlappingCell(const Segment &s, float margin, F &&f) const;
+};
@@ -8,3 +8,9 @@ static const int max_offsets = 10000;
 static const int max_indices = 10000;
 
 static const int grid_size = 10;
+
+static const bool executor_skip_smt = false;
+static const int first_touch_min_bytes = 1 << 20;
+
+static const bool export_state = false; // Publish live state for tools/state_reader
+static const char *const state_export_name = "/particle_state";
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../include/simulation.hpp"
+#include "../include/halo_transport.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct HaloHeader {
+    int num_migrants;
+    int num_halo;
+};
+
+// Owns one vertical strip [x_min, x_max) of the box. Particles that leave the
+// strip migrate to the neighbouring rank, and particles within `halo_width` of
+// an edge are mirrored to the neighbour as ghosts for the collision pass.
+class DomainWorker {
+public:
+    DomainWorker(Simulation &sim, HaloTransport &transport, int rank, int num_ranks, float x_min, float x_max, float halo_width);
+
+    void dropForeign();
+    void substep(float dt);
+
+    int rank, num_ranks;
+    float x_min, x_max;
+    float halo_width;
+
+private:
+    Simulation &sim;
+    HaloTransport &transport;
+
+    std::vector<Particle> migrants[2]; // To rank - 1, rank + 1
+    std::vector<Particle> halo[2];
+    std::vector<char> sendBuffer;
+    std::vector<char> recvBuffer;
+
+    void exchange();
+};
+
+struct DomainConfig {
+    int num_ranks = 2;
+    int width = DEFAULT_WIDTH;
+    int height = DEFAULT_HEIGHT;
+
+    int frames = 1000;
+    int substeps = 10;
+    float dt = 6.0f;
+
+    float halo_width = grid_size;
+    size_t ring_capacity = 4 * sizeof(Particle) * max_particles;
+    std::string shm_prefix = "/particle_domain";
+
+    // Both run inside the rank's own process. Particles added by setup outside
+    // the rank's strip are dropped, so every rank may add the full scene.
+    std::function<void(Simulation &sim, int rank)> setup;
+    std::function<void(Simulation &sim, int rank, int frame)> on_frame;
+};
+
+struct DomainResult {
+    std::vector<int> owned; // Particles owned by all ranks, before the first frame and after each one
+    double seconds = 0.0;   // Wall time of the slowest rank's frames
+};
+
+// Forks one process per rank, runs them to completion and cleans up the
+// shared memory rings. Throws if any rank fails or the ranks together ever
+// own a different number of particles than they started with.
+DomainResult run_domains(const DomainConfig &config);
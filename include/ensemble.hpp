@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../include/simulation.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Parameters that vary between members of one ensemble
+struct EnsembleMember {
+    float dampening = 0.6f;
+    float dt = 6.0f;
+    int substeps = 10;
+
+    int spawn_interval = 2;  // Frames between spawns, 0 disables spawning
+    int spawn_count = 10;    // Particles added per spawn
+};
+
+// Shared by every member and never written once the ensemble starts
+struct EnsembleConfig {
+    int width = 400;
+    int height = 400;
+    int frames = 600;
+
+    int max_particles = 20000; // Per member, the spawner stops here
+    int spawn_until = 400;     // Last frame that may spawn
+    float radius = 2.0f;
+
+    // Called once per member before its first frame, e.g. to add colliders
+    std::function<void(Simulation &sim, int member)> setup;
+};
+
+struct EnsembleResult {
+    int member;
+    int num_particles;
+    int removed_particles;
+    float mean_height;
+    float mean_speed;   // Displacement per unit of dt over the last substep
+    uint64_t hash;      // hash_particles of the final state
+    double seconds;
+};
+
+// Runs every member to completion as one job on the executor. Members run
+// on different workers with their own Simulation and grid, and all work
+// inside a member runs inline on that worker. Throws if any member fails.
+std::vector<EnsembleResult> run_ensemble(const EnsembleConfig &config, const std::vector<EnsembleMember> &members);
+
+// One line per member: its parameters followed by its results
+void write_ensemble_csv(const std::string &path, const std::vector<EnsembleMember> &members, const std::vector<EnsembleResult> &results);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../include/particle.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Point to point channel between neighbouring domains. Every substep each
+// domain sends exactly one message to each neighbour and then receives one
+// from each, so a transport only has to keep messages in order per neighbour.
+class HaloTransport {
+public:
+    virtual ~HaloTransport() = default;
+
+    virtual void send(int neighbour, const void *data, size_t size) = 0;
+    virtual void receive(int neighbour, std::vector<char> &out) = 0; // Blocks until a message arrives
+};
+
+struct RingHeader {
+    std::atomic<uint64_t> head; // Bytes written, only advanced by the producer
+    std::atomic<uint64_t> tail; // Bytes read, only advanced by the consumer
+    uint64_t capacity;
+};
+
+// Single producer, single consumer byte ring living in a POSIX shared memory
+// segment. Messages are length prefixed and may wrap around the end.
+class ShmRing {
+public:
+    ShmRing(const std::string &name, size_t capacity, bool create);
+    ~ShmRing();
+
+    ShmRing(const ShmRing&) = delete;
+
+    void write(const void *data, size_t size);
+    void read(std::vector<char> &out);
+
+    static void unlink(const std::string &name);
+
+private:
+    RingHeader *header;
+    char *data;
+    size_t mapped_size;
+
+    void copyIn(uint64_t pos, const void *src, size_t size);
+    void copyOut(uint64_t pos, void *dst, size_t size);
+};
+
+// Shared memory transport for domains laid out as a row of strips. Ring names
+// are derived from `prefix` and the sending/receiving ranks; the rings must
+// already exist, see createRings.
+class ShmTransport : public HaloTransport {
+public:
+    ShmTransport(const std::string &prefix, int rank, int num_ranks);
+
+    void send(int neighbour, const void *data, size_t size) override;
+    void receive(int neighbour, std::vector<char> &out) override;
+
+    static std::string ringName(const std::string &prefix, int from, int to);
+    static std::vector<std::unique_ptr<ShmRing>> createRings(const std::string &prefix, int num_ranks, size_t capacity);
+    static void unlinkRings(const std::string &prefix, int num_ranks);
+
+private:
+    int rank;
+    std::unique_ptr<ShmRing> outgoing[2]; // To rank - 1, rank + 1
+    std::unique_ptr<ShmRing> incoming[2];
+
+    int side(int neighbour) const;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../include/particle.hpp"
+#include "../utils/thread_pool.hpp"
+
+#include <vector>
+
+struct Link {
+    int a;
+    int b;
+    float rest_length;
+    float stiffness;
+};
+
+// Distance constraints between particle pairs. Links are graph coloured so
+// that no two links of the same colour share a particle, then stored grouped
+// by colour: every colour is a batch that can be solved fully in parallel
+// without locks or atomics.
+class LinkSet {
+public:
+    void add(int a, int b, float rest_length, float stiffness = 1.0f);
+    void clear();
+
+    void color(int num_particles);
+    void solve(ParticleVector &particles, ThreadPool &threader);
+
+    // One XPBD iteration. alphaTilde is the compliance over dt squared, each
+    // link uses alphaTilde / stiffness. Call resetLambdas once per substep.
+    void solveCompliant(ParticleVector &particles, ThreadPool &threader, float alphaTilde);
+    void resetLambdas() { lambdas.assign(links.size(), 0.0f); }
+
+    bool empty() const { return links.empty(); }
+    int num_colors() const { return (int)colorOffsets.size() - 1; }
+
+    bool dirty = true;
+
+    std::vector<Link> links;
+    std::vector<int> colorOffsets;
+    std::vector<float> lambdas; // Parallel to links
+};
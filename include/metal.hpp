@@ -28,8 +28,8 @@ public:
     MetalCompute() { init_metal(); }
     ~MetalCompute();
 
-    void updateBuffers(std::vector<Particle> particles, std::vector<int> indices, std::vector<int> offsets, Constants c); 
-    void loadFromBuffers(std::vector<Particle> &particles);
+    void updateBuffers(const ParticleVector &particles, const std::vector<int> &indices, const std::vector<int> &offsets, const Constants &c); 
+    void loadFromBuffers(ParticleVector &particles);
 
     void handle_collisions();
     void handle_box_constraints();
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+enum class PackingLayout {
+    Hexagonal, // Touching rows, no overlaps, no relaxation needed
+    Random     // Uniform positions at close packing density, relax afterwards
+};
+
+// A bed of particles filled from the bottom of [min, max] upwards
+struct PackingConfig {
+    PackingLayout layout = PackingLayout::Hexagonal;
+    int count = 10000;
+    glm::vec2 min;
+    glm::vec2 max;
+
+    float radius = 2.0f;
+    float radius_spread = 0.0f; // Radii uniform in radius +- radius_spread
+    uint32_t seed = 1;
+
+    int relax_iterations = 0;   // Overlap-only passes run after placement
+};
@@ -1,11 +1,13 @@
 #pragma once
 
 #include "../include/particle.hpp"
+#include "../utils/executor.hpp"
 
 #include <glm/glm.hpp>
 
 #include <string>
 #include <sstream>
+#include <vector>
 
 struct Particle {
     glm::vec3 position;
@@ -15,6 +17,9 @@ struct Particle {
     float mass;
     float radius;
 
+    int id = -1;      // Stable across compaction and reordering, assigned by the simulation
+    float age = 0.0f;
+
     std::string _print() const {
         std::ostringstream oss;
         oss << "Particle("
@@ -26,6 +31,12 @@ struct Particle {
     }
 };
 
+// Shared with the Metal kernels, which see it as 13 plain floats and ints
+// (shaders/shaders.metal); rebuild the metallib whenever this changes
+static_assert(sizeof(Particle) == 13 * sizeof(float), "Particle layout must match shaders.metal");
+
+using ParticleVector = std::vector<Particle, FirstTouchAllocator<Particle>>;
+
 Particle create_particle(glm::vec3 position, glm::vec3 position_last, glm::vec2 acceleration, float mass, float radius);
 
 void update_particle(Particle &p, float dt);
@@ -6,7 +6,7 @@
 
 #include "../include/particle.hpp"
 #include "../include/config.hpp"
-#include "../utils/thread_pool.hpp"
+#include "../utils/executor.hpp"
 
 class Renderer {
 public:
@@ -20,9 +20,9 @@ public:
         return window;
     }
 
-    void drawFrame(std::vector<Particle> particles);
+    void drawFrame(const ParticleVector &particles);
 
-    ThreadPool threader{std::thread::hardware_concurrency() * 4};
+    ThreadPool &threader = executor();
 
     const uint get_width() { return window_width; }
     const uint get_height() { return window_height; }
@@ -43,6 +43,8 @@ private:
     uint window_height = DEFAULT_HEIGHT;
     SDL_Texture* circleTexture;
 
+    std::vector<SDL_Rect> rects; // Reused every frame
+
     void updateFpsText(float fps);
 
     void createCircleTexture();
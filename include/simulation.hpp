@@ -3,44 +3,226 @@
 #include "../include/particle.hpp"
 #include "../include/config.hpp"
 #include "../include/metal.hpp"
+#include "../include/collider.hpp"
+#include "../include/links.hpp"
+#include "../include/barnes_hut.hpp"
+#include "../include/state_hash.hpp"
+#include "../include/spatial_query.hpp"
+#include "../include/packing.hpp"
 
-#include "../utils/thread_pool.hpp"
+#include "../utils/executor.hpp"
+#include "../utils/load_balancer.hpp"
+#include "../utils/arena.hpp"
+
+#include <algorithm>
+
+struct Sink {
+    glm::vec2 min;
+    glm::vec2 max;
+};
 
 class Simulation {
 public:
     float dampening = 0.6;
+    bool use_long_range = false;
+    bool use_neighbour_lists = false; // CPU path only
+    bool use_fused = false;           // CPU path only, single streaming pass per substep
+    float skin = 4.0f;                // 2 * radius + skin must fit in one grid cell
+    // Bit reproducible regardless of thread count. The CPU solvers already
+    // are, the row parity passes never race and chunks are combined in a
+    // fixed order. This also stops the balancers from learning chunk
+    // boundaries from timings, so the schedule repeats run to run. The GPU
+    // path is rejected.
+    bool deterministic = false;
+    int hash_interval = 0;            // Substeps between state hashes, 0 disables
+    float max_age = 0.0f;             // Particles older than this are removed, 0 disables
+    bool cell_major = false;          // Store particles in grid cell order, see sortByCell
+
+    // XPBD mode, CPU path only: a few cheap constraint iterations per substep
+    // over cached contacts, with restitution taken from dampening
+    bool use_xpbd = false;
+    int xpbd_iterations = 4;
+    float contact_compliance = 0.0f;  // Inverse stiffness, 0 is rigid
+    float link_compliance = 0.0f;     // Divided by each link's stiffness
+    float contact_margin = 1.0f;      // 2 * radius + margin must fit in one grid cell
 
     Simulation(MetalCompute& metalHandler, int width, int height);
+    Simulation(int width, int height); // CPU only, never touches Metal
     ~Simulation() = default;
 
     void run(int num_iterations, float dt, int frameNum);
     
     void updateParticles(float dt);
+    void applyLongRangeForces();
     
     void boxConstraint();
+    void fusedSubstep(float dt);
+    void xpbdSubstep(float dt);
     void circleConstraint();
 
     void handleCollisionsGeneral();
     void handleGridCollisions(int x, int y);
     void handleCollisions();
+    void handleColliderCollisions();
+    void handleNeighbourListCollisions();
+    void solveLinks();
+
+    void addLink(int a, int b, float stiffness = 1.0f);
+    int addChain(glm::vec2 from, glm::vec2 to, int count, float radius, float stiffness = 1.0f);
+    int addCloth(glm::vec2 origin, int cols, int rows, float spacing, float radius, float stiffness = 1.0f);
+    int addBlob(glm::vec2 center, int count, float blob_radius, float radius, float stiffness = 0.2f);
+
+    // Places a settled bed directly instead of spawning and waiting. Returns
+    // the index of the first new particle, throws if the region cannot hold
+    // config.count particles. relaxOverlaps only pushes
+    // overlapping particles apart, without adding velocity, and returns the
+    // largest overlap left.
+    int addPacking(const PackingConfig &config);
+    float relaxOverlaps(int iterations);
+
+    void removeParticles(float elapsed);
 
     void init_grid();
     void update_grid();
+    void ensureGrid();
 
-    std::vector<Particle> particles;
+    // Batched grid queries, no allocation. Radius and box queries write up to
+    // `capacity` particle indices per query at results + q * capacity and the
+    // full match count to counts[q]. Nearest writes k indices and distances
+    // per query, sorted, padded with -1 and INFINITY.
+    void queryRadius(const RadiusQuery *queries, int num_queries, int *results, int capacity, int *counts);
+    void queryBox(const BoxQuery *queries, int num_queries, int *results, int capacity, int *counts);
+    void countInBox(const BoxQuery *queries, int num_queries, int *counts);
+    void queryNearest(const glm::vec2 *points, int num_queries, int k, int *results, float *distances);
 
-    ThreadPool threader{std::thread::hardware_concurrency() * 4};
+    bool needsNeighbourRebuild();
+    void buildNeighbourLists();
+
+    ParticleVector particles;
+
+    ThreadPool &threader = executor();
     
     std::vector<int> cellOffsets;
     std::vector<int> cellIndices;
 
+    // Candidate pairs within 2 * radius + skin, rebuilt once a particle has
+    // moved more than half the skin since the last build. Lists are kept per
+    // grid slot of the build (particle neighbourOrder[k], grid row y covers
+    // slots neighbourRows[y]..neighbourRows[y + 1]) and hold the same forward
+    // stencil as handleGridCollisions, so they are solved in the same order.
+    std::vector<int> neighbourOffsets;
+    std::vector<int> neighbourIndices;
+    std::vector<int> neighbourOrder;
+    std::vector<int> neighbourRows;
+    std::vector<glm::vec2> buildPositions;
+    std::vector<glm::vec2> collisionDeltas;
+    int neighbour_rebuilds = 0;
+
+    // Split points for the collision passes, weighted by particles per row or
+    // candidates per particle and corrected by last substep's chunk timings
+    std::vector<int> rowPrefix;
+    LoadBalancer rowBalancer;
+    LoadBalancer contactBalancer;
+
+    // Particles entering a sink are removed at the start of the next frame
+    std::vector<Sink> sinks;
+    int next_id = 0;
+    int removed_particles = 0;
+
+    ColliderSet colliders;
+    LinkSet links;
+    BarnesHut longRange;
+
+    int step = 0;
+    std::vector<StateHash> hashLog; // Grows at the start of run(), reserve ahead to keep run() allocation free
+
     int width, height, grid_width, grid_height;
+    int grid_x0 = 0; // Box column of grid column 0, see setGridColumns
 
     const inline int grid_index(int x, int y) { return x + grid_width * y; }
     const inline int num_cells() { return grid_width * grid_height; }
 
+    // Cell of a position, clamped to the grid
+    inline int cell_key(const glm::vec3 &position) const {
+        int gx = std::clamp((int)(position.x / grid_size) - grid_x0, 0, grid_width - 1);
+        int gy = std::clamp((int)(position.y / grid_size), 0, grid_height - 1);
+        return gx + grid_width * gy;
+    }
+
+    // Calls f(j) for every particle j binned in the 3x3 cells around position
+    template <class F>
+    inline void forEachNearby(const glm::vec3 &position, F &&f) {
+        int key = cell_key(position);
+        int gx = key % grid_width;
+        int gy = key / grid_width;
+
+        for (int ny = std::max(gy - 1, 0); ny <= std::min(gy + 1, grid_height - 1); ny++) {
+            for (int nx = std::max(gx - 1, 0); nx <= std::min(gx + 1, grid_width - 1); nx++) {
+                int cellIndex = grid_index(nx, ny);
+                for (int k = cellOffsets[cellIndex]; k < cellOffsets[cellIndex + 1]; k++) {
+                    f(cellIndices[k]);
+                }
+            }
+        }
+    }
+
     void setWindowSize(int width, int height);
 
+    // Narrows the grid to the columns covering [x_min, x_max) of the box, for
+    // a process that only simulates a strip. Particles outside land in the
+    // edge columns. CPU path only, call init_grid afterwards.
+    void setGridColumns(float x_min, float x_max);
+
 private:
-    MetalCompute &metalHandler;
+    MetalCompute *metalHandler;
+
+    void constrainToBox(Particle& p);
+
+    // Moves particles into cell order after a grid build, so cellIndices
+    // becomes the identity and neighbour cells are contiguous slices.
+    // Indices change on every call, Particle::id does not. Collisions give
+    // the same result as the default storage, long-range sums do not, they
+    // still run in storage order.
+    void sortByCell();
+    ParticleVector sorted;
+    std::vector<glm::vec2> sortedPositions;
+
+    // Scratch reused across frames so a steady-state run() does not allocate
+    FrameArena frameArena;
+    std::vector<int> cellCounts;
+
+    struct Contact {
+        int a, b;
+        float lambda;
+        float normal_velocity; // Before the substep's position solve
+    };
+
+    // Contacts of grid row y are chunkContacts[c][contactRowBegin[y]..contactRowEnd[y])
+    // for the rowBalancer chunk c that owns the row
+    std::vector<std::vector<Contact>> chunkContacts;
+    std::vector<int> contactRowBegin;
+    std::vector<int> contactRowEnd;
+
+    void buildContacts();
+    void solveContacts(float alphaTilde);
+    void applyRestitution(float dt);
+
+    // Set while the last fused substep's box pass has not run yet
+    bool boxPending = false;
+    void flushFusedBox();
+
+    // Set when particles moved since the grid was built and nothing rebuilt
+    // it, see ensureGrid
+    bool gridStale = false;
+
+    std::vector<int> fusedBounds;
+    std::vector<int> cellKeys;
+    std::vector<int> chunkHistograms;
+
+    ParticleVector compacted;
+    std::vector<unsigned char> keep;
+    std::vector<int> remap;
+    std::vector<int> chunkBounds;
+    std::vector<int> chunkKept;
+    std::vector<int> chunkNew;
 };
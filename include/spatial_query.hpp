@@ -0,0 +1,13 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+struct RadiusQuery {
+    glm::vec2 center;
+    float radius;
+};
+
+struct BoxQuery {
+    glm::vec2 min;
+    glm::vec2 max;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Shared memory layout for live particle state. The writer rotates through
+// three slots and only ever writes a slot other than `latest`, so it never
+// waits for readers. Each slot is guarded by a sequence number (odd while
+// being written): a reader copies the latest slot and retries if the number
+// changed underneath it, so it never sees a torn frame.
+
+static const uint64_t state_export_magic = 0x5041525449434c45ull; // "PARTICLE"
+static const uint32_t state_export_version = 3;
+static const int state_export_slots = 3;
+
+struct ExportHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t max_particles;
+    uint32_t max_cells;
+    uint32_t slot_bytes;
+    std::atomic<int32_t> latest; // -1 until the first frame is published
+    int32_t writer_pid;          // A new writer only replaces the segment once this process is gone
+};
+
+struct ExportSlot {
+    std::atomic<uint64_t> sequence;
+    uint64_t frame;
+    int32_t num_particles; // Particles stored, capped at max_particles
+    int32_t total_particles;
+    int32_t grid_width;
+    int32_t grid_height;
+    int32_t has_density;
+    int32_t padding;
+    // Followed by float positions[2 * max_particles], int32_t ids[max_particles]
+    // and int32_t density[max_cells]
+};
+
+inline size_t export_slot_bytes(uint32_t max_particles, uint32_t max_cells) {
+    size_t bytes = sizeof(ExportSlot) + sizeof(float) * 2 * max_particles + sizeof(int32_t) * (max_particles + max_cells);
+    return (bytes + 63) / 64 * 64;
+}
+
+inline float *export_positions(ExportSlot *slot) {
+    return reinterpret_cast<float *>(slot + 1);
+}
+
+inline int32_t *export_ids(ExportSlot *slot, uint32_t max_particles) {
+    return reinterpret_cast<int32_t *>(export_positions(slot) + 2 * max_particles);
+}
+
+inline int32_t *export_density(ExportSlot *slot, uint32_t max_particles) {
+    return export_ids(slot, max_particles) + max_particles;
+}
+
+class Simulation;
+
+class StateExporter {
+public:
+    StateExporter(const std::string &name, int max_particles, int max_cells);
+    ~StateExporter();
+
+    StateExporter(const StateExporter&) = delete;
+
+    void publish(uint64_t frame, Simulation &sim, bool density = true);
+
+private:
+    std::string name;
+    ExportHeader *header;
+    char *slots;
+    size_t mapped_size;
+};
+
+struct StateFrame {
+    uint64_t frame = 0;
+    int total_particles = 0;
+    int grid_width = 0;
+    int grid_height = 0;
+    std::vector<float> positions; // x, y pairs
+    std::vector<int32_t> ids;     // Stable across frames, the storage order is not
+    std::vector<int32_t> density; // Empty unless the writer exported it
+};
+
+// Read only view for consumer processes
+class StateReader {
+public:
+    StateReader(const std::string &name) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            throw std::runtime_error("No live state published under " + name);
+        }
+
+        ExportHeader probe;
+        struct stat info;
+        if (pread(fd, &probe, sizeof(ExportHeader), 0) != sizeof(ExportHeader) || probe.magic != state_export_magic || probe.version != state_export_version
+            || probe.slot_bytes < export_slot_bytes(probe.max_particles, probe.max_cells)
+            || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ExportHeader) + (size_t)probe.slot_bytes * state_export_slots) {
+            close(fd);
+            throw std::runtime_error("Incompatible live state segment " + name);
+        }
+
+        // The layout is fixed once the magic is set, keep it rather than
+        // trusting the shared copy on every read
+        max_particles = probe.max_particles;
+        max_cells = probe.max_cells;
+        slot_bytes = probe.slot_bytes;
+
+        mapped_size = sizeof(ExportHeader) + (size_t)probe.slot_bytes * state_export_slots;
+        void *mem = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED) {
+            throw std::runtime_error("Failed to map live state " + name);
+        }
+
+        header = static_cast<const ExportHeader *>(mem);
+        slots = static_cast<const char *>(mem) + sizeof(ExportHeader);
+    }
+
+    ~StateReader() {
+        munmap(const_cast<ExportHeader *>(header), mapped_size);
+    }
+
+    StateReader(const StateReader&) = delete;
+
+    // Copies the most recent complete frame, false if nothing was published yet
+    bool read(StateFrame &out) {
+        for (;;) {
+            int latest = header->latest.load(std::memory_order_acquire);
+            if (latest < 0 || latest >= state_export_slots) return false;
+
+            const ExportSlot *slot = reinterpret_cast<const ExportSlot *>(slots + (size_t)latest * slot_bytes);
+            uint64_t before = slot->sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Counts come from another process, never copy past the slot
+            int num_particles = std::clamp<int64_t>(slot->num_particles, 0, max_particles);
+            int num_cells = slot->has_density ? std::clamp<int64_t>((int64_t)slot->grid_width * slot->grid_height, 0, max_cells) : 0;
+
+            out.frame = slot->frame;
+            out.total_particles = slot->total_particles;
+            out.grid_width = slot->grid_width;
+            out.grid_height = slot->grid_height;
+
+            ExportSlot *mutableSlot = const_cast<ExportSlot *>(slot);
+            out.positions.resize(2 * num_particles);
+            memcpy(out.positions.data(), export_positions(mutableSlot), sizeof(float) * 2 * num_particles);
+            out.ids.resize(num_particles);
+            memcpy(out.ids.data(), export_ids(mutableSlot, max_particles), sizeof(int32_t) * num_particles);
+            out.density.resize(num_cells);
+            memcpy(out.density.data(), export_density(mutableSlot, max_particles), sizeof(int32_t) * num_cells);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->sequence.load(std::memory_order_relaxed) == before) return true;
+        }
+    }
+
+private:
+    const ExportHeader *header;
+    const char *slots;
+    size_t mapped_size;
+    uint32_t max_particles;
+    uint32_t max_cells;
+    uint32_t slot_bytes;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "../include/particle.hpp"
+#include "../utils/thread_pool.hpp"
+#include "../utils/arena.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct StateHash {
+    int step;
+    uint64_t hash;
+};
+
+// Hash of every particle's id, current and previous position. Per-particle
+// hashes are combined by a sum, so the result depends neither on the number of
+// threads nor on storage order, cell_major included. Per-chunk sums live in
+// scratch.
+uint64_t hash_particles(const ParticleVector &particles, ThreadPool &threader, FrameArena &scratch);
+
+// Step of the first checkpoint present in both logs whose hashes differ, or -1
+int first_divergence(const std::vector<StateHash> &a, const std::vector<StateHash> &b);
+
+void write_hash_log(const std::string &path, const std::vector<StateHash> &log);
+std::vector<StateHash> read_hash_log(const std::string &path);
@@ -15,6 +15,9 @@ struct Particle {
 
     float mass;
     float radius;
+
+    int id;
+    float age;
 };
 
 struct Constants {
@@ -0,0 +1,228 @@
+#include "../include/barnes_hut.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static inline int quadrant(glm::vec2 p, glm::vec2 center) {
+    return (p.x >= center.x) + 2 * (p.y >= center.y);
+}
+
+static inline glm::vec2 child_center(glm::vec2 center, float half_size, int q) {
+    float h = half_size * 0.5f;
+    return center + glm::vec2((q & 1) ? h : -h, (q & 2) ? h : -h);
+}
+
+static QuadNode empty_node(glm::vec2 center, float half_size) {
+    QuadNode n;
+    n.center_of_mass = center;
+    n.mass = 0.0f;
+    n.center = center;
+    n.half_size = half_size;
+    n.children[0] = n.children[1] = n.children[2] = n.children[3] = -1;
+    n.first = 0;
+    n.count = 0;
+    return n;
+}
+
+int BarnesHut::buildNode(std::vector<QuadNode> &arena, const ParticleVector &particles, int first, int count, glm::vec2 center, float half_size, int depth) {
+    int index = arena.size();
+    arena.push_back(empty_node(center, half_size));
+    arena[index].first = first;
+    arena[index].count = count;
+
+    if (count <= leaf_size || depth >= max_depth) {
+        glm::vec2 weighted{};
+        float mass = 0.0f;
+        for (int i = first; i < first + count; i++) {
+            const Particle &p = particles[order[i]];
+            weighted += glm::vec2(p.position.x, p.position.y) * p.mass;
+            mass += p.mass;
+        }
+        arena[index].mass = mass;
+        arena[index].center_of_mass = mass > 0.0f ? weighted / mass : center;
+        return index;
+    }
+
+    auto pos = [&](int i) { return glm::vec2(particles[i].position.x, particles[i].position.y); };
+
+    // Split the range in place into the four quadrants: bottom/top, then left/right
+    int *begin = order.data() + first;
+    int *end = begin + count;
+    int *midY = std::partition(begin, end, [&](int i) { return pos(i).y < center.y; });
+    int *midX0 = std::partition(begin, midY, [&](int i) { return pos(i).x < center.x; });
+    int *midX1 = std::partition(midY, end, [&](int i) { return pos(i).x < center.x; });
+
+    int *bounds[5] = {begin, midX0, midY, midX1, end};
+
+    glm::vec2 weighted{};
+    float mass = 0.0f;
+
+    for (int q = 0; q < 4; q++) {
+        int childCount = bounds[q + 1] - bounds[q];
+        if (childCount == 0) continue;
+
+        int childFirst = bounds[q] - order.data();
+        int child = buildNode(arena, particles, childFirst, childCount, child_center(center, half_size, q), half_size * 0.5f, depth + 1);
+
+        arena[index].children[q] = child;
+        weighted += arena[child].center_of_mass * arena[child].mass;
+        mass += arena[child].mass;
+    }
+
+    arena[index].mass = mass;
+    arena[index].center_of_mass = mass > 0.0f ? weighted / mass : center;
+    return index;
+}
+
+void BarnesHut::build(const ParticleVector &particles, ThreadPool &threader) {
+    int num_particles = particles.size();
+    nodes.clear();
+    if (num_particles == 0) return;
+
+    glm::vec2 lo = glm::vec2(particles[0].position.x, particles[0].position.y);
+    glm::vec2 hi = lo;
+    for (const Particle &p : particles) {
+        lo = glm::min(lo, glm::vec2(p.position.x, p.position.y));
+        hi = glm::max(hi, glm::vec2(p.position.x, p.position.y));
+    }
+
+    glm::vec2 center = (lo + hi) * 0.5f;
+    float half_size = std::max(hi.x - lo.x, hi.y - lo.y) * 0.5f + 1e-3f;
+
+    // Bucket particles by their depth-2 cell so each subtree owns a contiguous range
+    order.resize(num_particles);
+    std::fill(subtreeCount, subtreeCount + num_subtrees, 0);
+
+    auto subtree_of = [&](const Particle &p) {
+        glm::vec2 pos = glm::vec2(p.position.x, p.position.y);
+        int q1 = quadrant(pos, center);
+        int q2 = quadrant(pos, child_center(center, half_size, q1));
+        return q1 * 4 + q2;
+    };
+
+    for (const Particle &p : particles) {
+        subtreeCount[subtree_of(p)]++;
+    }
+
+    int cursor[num_subtrees];
+    subtreeFirst[0] = 0;
+    for (int k = 1; k < num_subtrees; k++) {
+        subtreeFirst[k] = subtreeFirst[k - 1] + subtreeCount[k - 1];
+    }
+    std::copy(subtreeFirst, subtreeFirst + num_subtrees, cursor);
+
+    for (int i = 0; i < num_particles; i++) {
+        order[cursor[subtree_of(particles[i])]++] = i;
+    }
+
+    threader.Parallel(num_subtrees, [&](int start, int end) {
+        for (int k = start; k < end; k++) {
+            subtreeArenas[k].clear();
+            if (subtreeCount[k] == 0) continue;
+
+            glm::vec2 c1 = child_center(center, half_size, k / 4);
+            glm::vec2 c2 = child_center(c1, half_size * 0.5f, k % 4);
+            buildNode(subtreeArenas[k], particles, subtreeFirst[k], subtreeCount[k], c2, half_size * 0.25f, 2);
+        }
+    });
+
+    // Splice: root, four depth-1 nodes, then every subtree arena with shifted child indices
+    int base[num_subtrees];
+    int total = 5;
+    for (int k = 0; k < num_subtrees; k++) {
+        base[k] = total;
+        total += subtreeArenas[k].size();
+    }
+    nodes.resize(total);
+
+    threader.Parallel(num_subtrees, [&](int start, int end) {
+        for (int k = start; k < end; k++) {
+            for (int i = 0; i < (int)subtreeArenas[k].size(); i++) {
+                QuadNode n = subtreeArenas[k][i];
+                for (int q = 0; q < 4; q++) {
+                    if (n.children[q] >= 0) n.children[q] += base[k];
+                }
+                nodes[base[k] + i] = n;
+            }
+        }
+    });
+
+    nodes[0] = empty_node(center, half_size);
+    nodes[0].count = num_particles;
+
+    glm::vec2 rootWeighted{};
+    for (int q1 = 0; q1 < 4; q1++) {
+        QuadNode &level1 = nodes[1 + q1];
+        level1 = empty_node(child_center(center, half_size, q1), half_size * 0.5f);
+        level1.first = subtreeFirst[q1 * 4];
+
+        glm::vec2 weighted{};
+        for (int q2 = 0; q2 < 4; q2++) {
+            int k = q1 * 4 + q2;
+            level1.count += subtreeCount[k];
+            if (subtreeCount[k] == 0) continue;
+
+            const QuadNode &sub = nodes[base[k]];
+            level1.children[q2] = base[k];
+            weighted += sub.center_of_mass * sub.mass;
+            level1.mass += sub.mass;
+        }
+        if (level1.mass > 0.0f) level1.center_of_mass = weighted / level1.mass;
+        if (level1.count > 0) nodes[0].children[q1] = 1 + q1;
+
+        rootWeighted += level1.center_of_mass * level1.mass;
+        nodes[0].mass += level1.mass;
+    }
+    if (nodes[0].mass > 0.0f) nodes[0].center_of_mass = rootWeighted / nodes[0].mass;
+}
+
+void BarnesHut::accumulate(ParticleVector &particles, ThreadPool &threader) const {
+    if (nodes.empty()) return;
+
+    float theta2 = theta * theta;
+    float eps2 = softening * softening;
+
+    threader.Parallel(particles.size(), [&](int start, int end) {
+        int stack[4 * max_depth];
+
+        for (int i = start; i < end; i++) {
+            Particle &p = particles[i];
+            glm::vec2 pos = glm::vec2(p.position.x, p.position.y);
+            glm::vec2 a{};
+
+            int top = 0;
+            stack[top++] = 0;
+
+            while (top > 0) {
+                const QuadNode &n = nodes[stack[--top]];
+
+                glm::vec2 d = n.center_of_mass - pos;
+                float dist2 = glm::dot(d, d);
+                float size = 2.0f * n.half_size;
+
+                bool leaf = n.children[0] < 0 && n.children[1] < 0 && n.children[2] < 0 && n.children[3] < 0;
+
+                if (leaf) {
+                    for (int j = n.first; j < n.first + n.count; j++) {
+                        int other = order[j];
+                        if (other == i) continue;
+
+                        const Particle &q = particles[other];
+                        glm::vec2 dq = glm::vec2(q.position.x, q.position.y) - pos;
+                        float r2 = glm::dot(dq, dq) + eps2;
+                        a += dq * (strength * q.mass / (r2 * std::sqrt(r2)));
+                    }
+                } else if (size * size < theta2 * dist2) {
+                    float r2 = dist2 + eps2;
+                    a += d * (strength * n.mass / (r2 * std::sqrt(r2)));
+                } else {
+                    for (int q = 0; q < 4; q++) {
+                        if (n.children[q] >= 0) stack[top++] = n.children[q];
+                    }
+                }
+            }
+
+            accelerate_particle(p, glm::vec3(a, 0));
+        }
+    });
+}
@@ -0,0 +1,149 @@
+#include "../include/collider.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static bool segmentOverlapsBox(glm::vec2 a, glm::vec2 b, glm::vec2 lo, glm::vec2 hi) {
+    float t0 = 0.0f;
+    float t1 = 1.0f;
+    glm::vec2 d = b - a;
+
+    for (int axis = 0; axis < 2; axis++) {
+        if (std::fabs(d[axis]) < 1e-8f) {
+            if (a[axis] < lo[axis] || a[axis] > hi[axis]) return false;
+            continue;
+        }
+
+        float inv = 1.0f / d[axis];
+        float tNear = (lo[axis] - a[axis]) * inv;
+        float tFar = (hi[axis] - a[axis]) * inv;
+        if (tNear > tFar) std::swap(tNear, tFar);
+
+        t0 = std::max(t0, tNear);
+        t1 = std::min(t1, tFar);
+        if (t0 > t1) return false;
+    }
+    return true;
+}
+
+void ColliderSet::addSegment(glm::vec2 a, glm::vec2 b) {
+    segments.push_back(Segment{a, b});
+    dirty = true;
+}
+
+void ColliderSet::addPolygon(const std::vector<glm::vec2> &points, bool closed) {
+    if (points.size() < 2) return;
+
+    for (size_t i = 0; i + 1 < points.size(); i++) {
+        addSegment(points[i], points[i + 1]);
+    }
+    if (closed && points.size() > 2) {
+        addSegment(points.back(), points.front());
+    }
+}
+
+void ColliderSet::clear() {
+    segments.clear();
+    cellIndices.clear();
+    dirty = true;
+}
+
+template <class F>
+void ColliderSet::forEachOverlappingCell(const Segment &s, float margin, F &&f) const {
+    glm::vec2 lo = glm::min(s.a, s.b) - glm::vec2(margin, margin);
+    glm::vec2 hi = glm::max(s.a, s.b) + glm::vec2(margin, margin);
+
+    int x0 = std::max(0, (int)std::floor(lo.x / cell_size));
+    int y0 = std::max(0, (int)std::floor(lo.y / cell_size));
+    int x1 = std::min(grid_width - 1, (int)std::floor(hi.x / cell_size));
+    int y1 = std::min(grid_height - 1, (int)std::floor(hi.y / cell_size));
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            glm::vec2 cellLo = glm::vec2(x * cell_size - margin, y * cell_size - margin);
+            glm::vec2 cellHi = glm::vec2((x + 1) * cell_size + margin, (y + 1) * cell_size + margin);
+
+            if (segmentOverlapsBox(s.a, s.b, cellLo, cellHi)) {
+                f(x + y * grid_width);
+            }
+        }
+    }
+}
+
+void ColliderSet::build(int grid_width, int grid_height, int cell_size, float margin) {
+    this->grid_width = grid_width;
+    this->grid_height = grid_height;
+    this->cell_size = cell_size;
+
+    int num_cells = grid_width * grid_height;
+    cellOffsets.assign(num_cells + 1, 0);
+
+    for (const Segment &s : segments) {
+        forEachOverlappingCell(s, margin, [&](int cell) { cellOffsets[cell + 1]++; });
+    }
+
+    for (int i = 1; i <= num_cells; i++) {
+        cellOffsets[i] += cellOffsets[i - 1];
+    }
+
+    cellIndices.resize(cellOffsets[num_cells]);
+
+    std::vector<int> cursor(cellOffsets.begin(), cellOffsets.end() - 1);
+    for (int i = 0; i < (int)segments.size(); i++) {
+        forEachOverlappingCell(segments[i], margin, [&](int cell) { cellIndices[cursor[cell]++] = i; });
+    }
+
+    dirty = false;
+}
+
+void ColliderSet::collide(Particle &p, float dampening) const {
+    int gx = std::clamp((int)(p.position.x / cell_size), 0, grid_width - 1);
+    int gy = std::clamp((int)(p.position.y / cell_size), 0, grid_height - 1);
+
+    int cellIndex = gx + gy * grid_width;
+    int start = cellOffsets[cellIndex];
+    int end   = cellOffsets[cellIndex + 1];
+
+    for (int i = start; i < end; i++) {
+        const Segment &s = segments[cellIndices[i]];
+
+        glm::vec2 pos = glm::vec2(p.position.x, p.position.y);
+        glm::vec2 ab = s.b - s.a;
+        float lenSquared = glm::dot(ab, ab);
+        float t = lenSquared > 0.0f ? std::clamp(glm::dot(pos - s.a, ab) / lenSquared, 0.0f, 1.0f) : 0.0f;
+
+        glm::vec2 closest = s.a + ab * t;
+        glm::vec2 d = pos - closest;
+        glm::vec2 n;
+        float dist;
+
+        if (t > 0.0f && t < 1.0f) {
+            // Orient the normal towards the side the particle came from, so a
+            // particle pushed across a thin segment is returned, not ejected
+            glm::vec2 last = glm::vec2(p.position_last.x, p.position_last.y);
+            n = glm::vec2(-ab.y, ab.x) / std::sqrt(lenSquared);
+            if (glm::dot(last - s.a, n) < 0.0f) n = -n;
+            dist = glm::dot(d, n);
+        } else {
+            dist = glm::length(d);
+            if (dist < 1e-6f) continue;
+            n = d / dist;
+        }
+
+        if (dist >= p.radius) continue;
+
+        glm::vec3 vel = get_particle_velocity(p);
+
+        glm::vec2 resolved = closest + n * p.radius;
+        p.position.x = resolved.x;
+        p.position.y = resolved.y;
+
+        float vn = vel.x * n.x + vel.y * n.y;
+        if (vn < 0.0f) {
+            vel.x -= (1.0f + dampening) * vn * n.x;
+            vel.y -= (1.0f + dampening) * vn * n.y;
+        }
+
+        set_particle_velocity(p, vel, 1.0f);
+    }
+}
@@ -0,0 +1,254 @@
+#include "../include/domain.hpp"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+DomainWorker::DomainWorker(Simulation &sim, HaloTransport &transport, int rank, int num_ranks, float x_min, float x_max, float halo_width)
+    : rank(rank), num_ranks(num_ranks), x_min(x_min), x_max(x_max), halo_width(halo_width), sim(sim), transport(transport) {
+    if (!sim.links.empty()) {
+        throw std::runtime_error("Links are not supported across domains");
+    }
+    // Ghosts are told apart from owned particles by their place at the end of
+    // the array, which sorting by cell would scramble
+    if (sim.cell_major) {
+        throw std::runtime_error("Cell-major storage is not supported across domains");
+    }
+
+    // Only the strip and the ghosts around it are binned, so per rank grid
+    // work shrinks as ranks are added
+    sim.setGridColumns(x_min - halo_width, x_max + halo_width);
+}
+
+// Marks ghost copies so substep can check that none of them took an owned slot
+static const int ghost_id = INT_MIN;
+
+void DomainWorker::dropForeign() {
+    ParticleVector &particles = sim.particles;
+
+    int kept = 0;
+    for (int i = 0; i < (int)particles.size(); i++) {
+        float x = particles[i].position.x;
+        bool owned = (rank == 0 || x >= x_min) && (rank == num_ranks - 1 || x < x_max);
+        if (owned) particles[kept++] = particles[i];
+    }
+    particles.resize(kept);
+}
+
+void DomainWorker::substep(float dt) {
+    sim.updateParticles(dt);
+    sim.boxConstraint();
+
+    exchange();
+    int num_owned = sim.particles.size();
+
+    // Ghosts were appended after the owned particles, collide then discard them
+    for (int s = 0; s < 2; s++) {
+        for (Particle &ghost : halo[s]) ghost.id = ghost_id;
+        sim.particles.insert(sim.particles.end(), halo[s].begin(), halo[s].end());
+    }
+
+    sim.update_grid();
+    sim.handleCollisions();
+    sim.handleColliderCollisions();
+
+    for (int i = 0; i < (int)sim.particles.size(); i++) {
+        if ((sim.particles[i].id == ghost_id) != (i >= num_owned)) {
+            throw std::runtime_error("Owned particles and ghosts were reordered during a domain substep");
+        }
+    }
+    sim.particles.resize(num_owned);
+}
+
+void DomainWorker::exchange() {
+    ParticleVector &particles = sim.particles;
+    int neighbours[2] = {rank - 1, rank + 1};
+    bool hasNeighbour[2] = {rank > 0, rank < num_ranks - 1};
+
+    for (int s = 0; s < 2; s++) {
+        migrants[s].clear();
+        halo[s].clear();
+    }
+
+    int kept = 0;
+    for (int i = 0; i < (int)particles.size(); i++) {
+        const Particle &p = particles[i];
+
+        if (hasNeighbour[0] && p.position.x < x_min) {
+            migrants[0].push_back(p);
+        } else if (hasNeighbour[1] && p.position.x >= x_max) {
+            migrants[1].push_back(p);
+        } else {
+            if (hasNeighbour[0] && p.position.x < x_min + halo_width) halo[0].push_back(p);
+            if (hasNeighbour[1] && p.position.x >= x_max - halo_width) halo[1].push_back(p);
+            particles[kept++] = p;
+        }
+    }
+    particles.resize(kept);
+
+    for (int s = 0; s < 2; s++) {
+        if (!hasNeighbour[s]) continue;
+
+        HaloHeader header = {(int)migrants[s].size(), (int)halo[s].size()};
+        size_t migrantBytes = sizeof(Particle) * header.num_migrants;
+        size_t haloBytes = sizeof(Particle) * header.num_halo;
+
+        sendBuffer.resize(sizeof(HaloHeader) + migrantBytes + haloBytes);
+        memcpy(sendBuffer.data(), &header, sizeof(HaloHeader));
+        memcpy(sendBuffer.data() + sizeof(HaloHeader), migrants[s].data(), migrantBytes);
+        memcpy(sendBuffer.data() + sizeof(HaloHeader) + migrantBytes, halo[s].data(), haloBytes);
+
+        transport.send(neighbours[s], sendBuffer.data(), sendBuffer.size());
+    }
+
+    // Incoming migrants become owned, incoming halo replaces our outgoing halo
+    // as the ghost set. Our own migrants stay behind as ghosts for this substep.
+    for (int s = 0; s < 2; s++) {
+        if (!hasNeighbour[s]) continue;
+
+        transport.receive(neighbours[s], recvBuffer);
+
+        HaloHeader header;
+        memcpy(&header, recvBuffer.data(), sizeof(HaloHeader));
+
+        const Particle *incoming = reinterpret_cast<const Particle *>(recvBuffer.data() + sizeof(HaloHeader));
+        particles.insert(particles.end(), incoming, incoming + header.num_migrants);
+
+        halo[s].assign(incoming + header.num_migrants, incoming + header.num_migrants + header.num_halo);
+        halo[s].insert(halo[s].end(), migrants[s].begin(), migrants[s].end());
+    }
+}
+
+// counts[(frame + 1) * num_ranks + rank] is the rank's owned particles after
+// each frame, entry frame -1 is taken before the first substep
+static void run_rank(const DomainConfig &config, int rank, int *counts, double *seconds) {
+    ShmTransport transport(config.shm_prefix, rank, config.num_ranks);
+    Simulation sim(config.width, config.height);
+    sim.particles.clear();
+
+    if (config.setup) config.setup(sim, rank);
+
+    float strip = (float)config.width / config.num_ranks;
+    DomainWorker worker(sim, transport, rank, config.num_ranks, strip * rank, strip * (rank + 1), config.halo_width);
+    worker.dropForeign();
+    sim.init_grid();
+    counts[rank] = sim.particles.size();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < config.frames; frame++) {
+        for (int i = 0; i < config.substeps; i++) {
+            worker.substep(config.dt);
+        }
+        counts[(frame + 1) * config.num_ranks + rank] = sim.particles.size();
+        if (config.on_frame) config.on_frame(sim, rank, frame);
+    }
+    seconds[rank] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+DomainResult run_domains(const DomainConfig &config) {
+    auto rings = ShmTransport::createRings(config.shm_prefix, config.num_ranks, config.ring_capacity);
+
+    // Per rank results, written by the children into memory shared with us
+    size_t countBytes = sizeof(int) * (size_t)(config.frames + 1) * config.num_ranks;
+    size_t statsBytes = sizeof(double) * config.num_ranks + countBytes;
+    void *stats = mmap(nullptr, statsBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED) {
+        ShmTransport::unlinkRings(config.shm_prefix, config.num_ranks);
+        throw std::runtime_error("Failed to map domain statistics");
+    }
+    double *seconds = static_cast<double *>(stats);
+    int *counts = reinterpret_cast<int *>(seconds + config.num_ranks);
+
+    // Every rank gets its own contiguous slice of the cpus, otherwise each
+    // child's executor would pin a full pool to every core. With fewer cpus
+    // than ranks they have to share.
+    std::vector<int> cpus = Topology::discover().workerCpus(executor_skip_smt);
+    std::vector<std::vector<int>> rankCpus(config.num_ranks);
+    for (int rank = 0; rank < config.num_ranks; rank++) {
+        int count = cpus.size();
+        int begin = (long)count * rank / config.num_ranks;
+        int end = (long)count * (rank + 1) / config.num_ranks;
+        if (begin == end) {
+            rankCpus[rank].push_back(cpus[rank % count]);
+        } else {
+            rankCpus[rank].assign(cpus.begin() + begin, cpus.begin() + end);
+        }
+    }
+
+    // Unflushed output would otherwise be written once more by every child
+    fflush(nullptr);
+
+    std::vector<pid_t> children;
+    for (int rank = 0; rank < config.num_ranks; rank++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            for (pid_t child : children) kill(child, SIGKILL);
+            ShmTransport::unlinkRings(config.shm_prefix, config.num_ranks);
+            munmap(stats, statsBytes);
+            throw std::runtime_error("Failed to fork domain process");
+        }
+        if (pid == 0) {
+            int status = 0;
+            try {
+                restrict_to_cpus(rankCpus[rank]);
+                run_rank(config, rank, counts, seconds);
+            } catch (const std::exception &e) {
+                fprintf(stderr, "Domain %d failed: %s\n", rank, e.what());
+                status = 1;
+            }
+            fflush(nullptr);
+            _exit(status);
+        }
+        children.push_back(pid);
+    }
+
+    // A failed rank would leave its neighbours blocked on receive, so take the rest down with it
+    bool failed = false;
+    for (int remaining = children.size(); remaining > 0; remaining--) {
+        int status;
+        if (waitpid(-1, &status, 0) < 0) break;
+
+        if (!failed && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+            failed = true;
+            for (pid_t child : children) kill(child, SIGKILL);
+        }
+    }
+
+    rings.clear();
+    ShmTransport::unlinkRings(config.shm_prefix, config.num_ranks);
+
+    DomainResult result;
+    if (!failed) {
+        result.owned.assign(config.frames + 1, 0);
+        for (int frame = 0; frame <= config.frames; frame++) {
+            for (int rank = 0; rank < config.num_ranks; rank++) {
+                result.owned[frame] += counts[frame * config.num_ranks + rank];
+            }
+        }
+        for (int rank = 0; rank < config.num_ranks; rank++) {
+            result.seconds = std::max(result.seconds, seconds[rank]);
+        }
+    }
+    munmap(stats, statsBytes);
+
+    if (failed) {
+        throw std::runtime_error("A domain process failed");
+    }
+
+    // Nothing is removed across domains, migration and halos must not lose or duplicate particles
+    for (int frame = 1; frame <= config.frames; frame++) {
+        if (result.owned[frame] != result.owned[0]) {
+            throw std::runtime_error("Domains own " + std::to_string(result.owned[frame]) + " particles after frame " + std::to_string(frame - 1)
+                + ", started with " + std::to_string(result.owned[0]));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,113 @@
+#include "../include/ensemble.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+
+static void spawn(Simulation &sim, const EnsembleConfig &config, const EnsembleMember &member) {
+    float spacing = 3.0f * config.radius;
+    float vx = 0.1f;
+    float vy = 0.1f;
+
+    for (int i = 0; i < member.spawn_count && (int)sim.particles.size() < config.max_particles; i++) {
+        float x = config.radius + spacing * (i + 1);
+        float y = 2.0f * config.radius;
+        if (x >= config.width - config.radius) break;
+
+        sim.particles.push_back(Particle{
+            glm::vec3(x, y, 0),
+            glm::vec3(x - vx, y - vy, 0),
+            glm::vec3{},
+            1.0f,
+            config.radius
+        });
+    }
+}
+
+static EnsembleResult run_member(const EnsembleConfig &config, const EnsembleMember &member, int index) {
+    auto start = std::chrono::steady_clock::now();
+
+    Simulation sim(config.width, config.height);
+    sim.dampening = member.dampening;
+    if (config.setup) config.setup(sim, index);
+
+    for (int frame = 1; frame <= config.frames; frame++) {
+        sim.run(member.substeps, member.dt, frame);
+
+        if (member.spawn_interval > 0 && frame <= config.spawn_until && frame % member.spawn_interval == 0) {
+            spawn(sim, config, member);
+        }
+    }
+
+    EnsembleResult result = {};
+    result.member = index;
+    result.num_particles = sim.particles.size();
+    result.removed_particles = sim.removed_particles;
+
+    double height = 0.0, speed = 0.0;
+    for (const Particle &p : sim.particles) {
+        height += p.position.y;
+        float dx = p.position.x - p.position_last.x;
+        float dy = p.position.y - p.position_last.y;
+        speed += std::sqrt(dx * dx + dy * dy) / member.dt;
+    }
+    if (result.num_particles > 0) {
+        result.mean_height = height / result.num_particles;
+        result.mean_speed = speed / result.num_particles;
+    }
+
+    FrameArena scratch;
+    result.hash = hash_particles(sim.particles, sim.threader, scratch);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+std::vector<EnsembleResult> run_ensemble(const EnsembleConfig &config, const std::vector<EnsembleMember> &members) {
+    ThreadPool &threader = executor();
+
+    std::vector<std::future<EnsembleResult>> futures;
+    futures.reserve(members.size());
+
+    // Each member is constructed on the worker that runs it, so its buffers
+    // are first touched there and its Parallel calls run inline
+    for (int i = 0; i < (int)members.size(); i++) {
+        futures.push_back(threader.enqueue(run_member, std::cref(config), std::cref(members[i]), i));
+    }
+
+    // Queued members still refer to config and members, so every one has to
+    // finish before an error from any of them leaves this function
+    std::vector<EnsembleResult> results;
+    results.reserve(members.size());
+    std::exception_ptr error;
+    for (auto &future : futures) {
+        try {
+            results.push_back(future.get());
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+    return results;
+}
+
+void write_ensemble_csv(const std::string &path, const std::vector<EnsembleMember> &members, const std::vector<EnsembleResult> &results) {
+    std::ofstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open ensemble results " + path);
+    }
+
+    file << "member,dampening,dt,substeps,spawn_interval,spawn_count,"
+         << "num_particles,removed_particles,mean_height,mean_speed,hash,seconds\n";
+
+    for (const EnsembleResult &r : results) {
+        const EnsembleMember &m = members[r.member];
+        file << r.member << "," << m.dampening << "," << m.dt << "," << m.substeps << ","
+             << m.spawn_interval << "," << m.spawn_count << ","
+             << r.num_particles << "," << r.removed_particles << ","
+             << r.mean_height << "," << r.mean_speed << ","
+             << std::hex << r.hash << std::dec << "," << r.seconds << "\n";
+    }
+}
@@ -0,0 +1,151 @@
+#include "../include/halo_transport.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+ShmRing::ShmRing(const std::string &name, size_t capacity, bool create) {
+    int fd = shm_open(name.c_str(), create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open shared memory ring " + name);
+    }
+
+    if (!create) {
+        RingHeader probe;
+        if (pread(fd, &probe.capacity, sizeof(uint64_t), offsetof(RingHeader, capacity)) != sizeof(uint64_t)) {
+            close(fd);
+            throw std::runtime_error("Failed to read shared memory ring " + name);
+        }
+        capacity = probe.capacity;
+    }
+
+    mapped_size = sizeof(RingHeader) + capacity;
+
+    if (create && ftruncate(fd, mapped_size) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to size shared memory ring " + name);
+    }
+
+    void *mem = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        throw std::runtime_error("Failed to map shared memory ring " + name);
+    }
+
+    header = static_cast<RingHeader *>(mem);
+    data = static_cast<char *>(mem) + sizeof(RingHeader);
+
+    if (create) {
+        new (&header->head) std::atomic<uint64_t>(0);
+        new (&header->tail) std::atomic<uint64_t>(0);
+        header->capacity = capacity;
+    }
+}
+
+ShmRing::~ShmRing() {
+    munmap(header, mapped_size);
+}
+
+void ShmRing::unlink(const std::string &name) {
+    shm_unlink(name.c_str());
+}
+
+void ShmRing::copyIn(uint64_t pos, const void *src, size_t size) {
+    size_t offset = pos % header->capacity;
+    size_t first = std::min(size, (size_t)(header->capacity - offset));
+
+    memcpy(data + offset, src, first);
+    memcpy(data, static_cast<const char *>(src) + first, size - first);
+}
+
+void ShmRing::copyOut(uint64_t pos, void *dst, size_t size) {
+    size_t offset = pos % header->capacity;
+    size_t first = std::min(size, (size_t)(header->capacity - offset));
+
+    memcpy(dst, data + offset, first);
+    memcpy(static_cast<char *>(dst) + first, data, size - first);
+}
+
+void ShmRing::write(const void *src, size_t size) {
+    uint64_t length = size;
+    size_t total = sizeof(uint64_t) + size;
+    if (total > header->capacity) {
+        throw std::runtime_error("Message larger than shared memory ring");
+    }
+
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    while (head + total - header->tail.load(std::memory_order_acquire) > header->capacity) {
+        std::this_thread::yield();
+    }
+
+    copyIn(head, &length, sizeof(uint64_t));
+    copyIn(head + sizeof(uint64_t), src, size);
+
+    header->head.store(head + total, std::memory_order_release);
+}
+
+void ShmRing::read(std::vector<char> &out) {
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    while (header->head.load(std::memory_order_acquire) == tail) {
+        std::this_thread::yield();
+    }
+
+    uint64_t length;
+    copyOut(tail, &length, sizeof(uint64_t));
+
+    out.resize(length);
+    copyOut(tail + sizeof(uint64_t), out.data(), length);
+
+    header->tail.store(tail + sizeof(uint64_t) + length, std::memory_order_release);
+}
+
+std::string ShmTransport::ringName(const std::string &prefix, int from, int to) {
+    return prefix + "_" + std::to_string(from) + "_" + std::to_string(to);
+}
+
+std::vector<std::unique_ptr<ShmRing>> ShmTransport::createRings(const std::string &prefix, int num_ranks, size_t capacity) {
+    unlinkRings(prefix, num_ranks);
+
+    std::vector<std::unique_ptr<ShmRing>> rings;
+    for (int r = 0; r + 1 < num_ranks; r++) {
+        rings.push_back(std::make_unique<ShmRing>(ringName(prefix, r, r + 1), capacity, true));
+        rings.push_back(std::make_unique<ShmRing>(ringName(prefix, r + 1, r), capacity, true));
+    }
+    return rings;
+}
+
+void ShmTransport::unlinkRings(const std::string &prefix, int num_ranks) {
+    for (int r = 0; r + 1 < num_ranks; r++) {
+        ShmRing::unlink(ringName(prefix, r, r + 1));
+        ShmRing::unlink(ringName(prefix, r + 1, r));
+    }
+}
+
+ShmTransport::ShmTransport(const std::string &prefix, int rank, int num_ranks) : rank(rank) {
+    if (rank > 0) {
+        outgoing[0] = std::make_unique<ShmRing>(ringName(prefix, rank, rank - 1), 0, false);
+        incoming[0] = std::make_unique<ShmRing>(ringName(prefix, rank - 1, rank), 0, false);
+    }
+    if (rank + 1 < num_ranks) {
+        outgoing[1] = std::make_unique<ShmRing>(ringName(prefix, rank, rank + 1), 0, false);
+        incoming[1] = std::make_unique<ShmRing>(ringName(prefix, rank + 1, rank), 0, false);
+    }
+}
+
+int ShmTransport::side(int neighbour) const {
+    if (neighbour == rank - 1 && outgoing[0]) return 0;
+    if (neighbour == rank + 1 && outgoing[1]) return 1;
+    throw std::runtime_error("Rank " + std::to_string(neighbour) + " is not a neighbour of " + std::to_string(rank));
+}
+
+void ShmTransport::send(int neighbour, const void *data, size_t size) {
+    outgoing[side(neighbour)]->write(data, size);
+}
+
+void ShmTransport::receive(int neighbour, std::vector<char> &out) {
+    incoming[side(neighbour)]->read(out);
+}
@@ -0,0 +1,133 @@
+#include "../include/links.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+void LinkSet::add(int a, int b, float rest_length, float stiffness) {
+    links.push_back(Link{a, b, rest_length, stiffness});
+    dirty = true;
+}
+
+void LinkSet::clear() {
+    links.clear();
+    colorOffsets.clear();
+    dirty = true;
+}
+
+void LinkSet::color(int num_particles) {
+    // Greedy never needs more than deg(a) + deg(b) - 1 colours for a link, so
+    // size the per particle colour masks for twice the highest degree
+    std::vector<int> degree(num_particles, 0);
+    int maxDegree = 0;
+    for (const Link &l : links) {
+        maxDegree = std::max(maxDegree, std::max(++degree[l.a], ++degree[l.b]));
+    }
+    int words = std::max(1, (2 * maxDegree + 63) / 64);
+
+    std::vector<uint64_t> used((size_t)num_particles * words, 0);
+    std::vector<int> linkColors(links.size());
+    std::vector<int> colorCounts(64 * words, 0);
+
+    int numColors = 0;
+
+    // Greedy colouring: take the lowest colour free at both endpoints
+    for (int i = 0; i < (int)links.size(); i++) {
+        const Link &l = links[i];
+        uint64_t *usedA = used.data() + (size_t)l.a * words;
+        uint64_t *usedB = used.data() + (size_t)l.b * words;
+
+        int w = 0;
+        while (w < words && (usedA[w] | usedB[w]) == ~0ull) w++;
+        if (w == words) {
+            throw std::runtime_error("Link colouring ran out of colours");
+        }
+
+        int bit = __builtin_ctzll(~(usedA[w] | usedB[w]));
+        usedA[w] |= 1ull << bit;
+        usedB[w] |= 1ull << bit;
+
+        int c = 64 * w + bit;
+        linkColors[i] = c;
+        colorCounts[c]++;
+        numColors = std::max(numColors, c + 1);
+    }
+
+    colorOffsets.assign(numColors + 1, 0);
+    for (int c = 0; c < numColors; c++) {
+        colorOffsets[c + 1] = colorOffsets[c] + colorCounts[c];
+    }
+
+    std::vector<Link> sorted(links.size());
+    std::vector<int> cursor(colorOffsets.begin(), colorOffsets.end() - 1);
+    for (int i = 0; i < (int)links.size(); i++) {
+        sorted[cursor[linkColors[i]]++] = links[i];
+    }
+
+    links.swap(sorted);
+    dirty = false;
+}
+
+void LinkSet::solve(ParticleVector &particles, ThreadPool &threader) {
+    if (dirty) color(particles.size());
+
+    for (int c = 0; c < num_colors(); c++) {
+        int batchStart = colorOffsets[c];
+        int batchSize = colorOffsets[c + 1] - batchStart;
+
+        threader.Parallel(batchSize, [&](int start, int end) {
+            for (int i = batchStart + start; i < batchStart + end; i++) {
+                const Link &l = links[i];
+                Particle &p1 = particles[l.a];
+                Particle &p2 = particles[l.b];
+
+                glm::vec3 v = p2.position - p1.position;
+                float dist = std::sqrt(v.x * v.x + v.y * v.y);
+                if (dist < 1e-8f) continue;
+
+                float w1 = 1.0f / p1.mass;
+                float w2 = 1.0f / p2.mass;
+
+                glm::vec3 correction = v * (l.stiffness * (dist - l.rest_length) / (dist * (w1 + w2)));
+
+                p1.position += correction * w1;
+                p2.position -= correction * w2;
+            }
+        });
+    }
+}
+
+void LinkSet::solveCompliant(ParticleVector &particles, ThreadPool &threader, float alphaTilde) {
+    if (dirty) color(particles.size());
+    if (lambdas.size() != links.size()) resetLambdas();
+
+    for (int c = 0; c < num_colors(); c++) {
+        int batchStart = colorOffsets[c];
+        int batchSize = colorOffsets[c + 1] - batchStart;
+
+        threader.Parallel(batchSize, [&](int start, int end) {
+            for (int i = batchStart + start; i < batchStart + end; i++) {
+                const Link &l = links[i];
+                Particle &p1 = particles[l.a];
+                Particle &p2 = particles[l.b];
+
+                glm::vec3 v = p2.position - p1.position;
+                float dist = std::sqrt(v.x * v.x + v.y * v.y);
+                if (dist < 1e-8f) continue;
+
+                float w1 = 1.0f / p1.mass;
+                float w2 = 1.0f / p2.mass;
+                float alpha = alphaTilde / std::max(l.stiffness, 1e-6f);
+
+                float constraint = dist - l.rest_length;
+                float deltaLambda = (-constraint - alpha * lambdas[i]) / (w1 + w2 + alpha);
+                lambdas[i] += deltaLambda;
+
+                glm::vec3 n = v / dist;
+                p1.position -= n * (w1 * deltaLambda);
+                p2.position += n * (w2 * deltaLambda);
+            }
+        });
+    }
+}
@@ -5,17 +5,39 @@
 #include "../include/renderer.hpp"
 #include "../include/metal.hpp"
 #include "../include/simulation.hpp"
+#include "../include/state_export.hpp"
 
 #include "/Users/alois/Desktop/projects/CustomUtils/print.hpp"
 
+#include <array>
 #include <chrono>
-#include <deque>
+#include <memory>
+
+#ifdef COUNT_ALLOCATIONS
+#include "../utils/alloc_counter.hpp"
+
+// Built with -DCOUNT_ALLOCATIONS (make check_allocs) the main loop fails once
+// a steady-state frame allocates. tools/alloc_check.cpp does the same headless.
+
+// Spawning stops by frame 1000, scratch buffers have settled well before this
+static const int steady_state_frame = 1100;
+#endif
 
 int main() {
     Renderer renderer{};
     MetalCompute metalCompute{};
     Simulation simulation(metalCompute, renderer.get_width(), renderer.get_height());
 
+    std::unique_ptr<StateExporter> exporter;
+    if (export_state) {
+        // Export is an extra, the simulation runs without it
+        try {
+            exporter = std::make_unique<StateExporter>(state_export_name, max_particles, simulation.num_cells());
+        } catch (const std::exception &e) {
+            fprintf(stderr, "State export disabled: %s\n", e.what());
+        }
+    }
+
     auto prevTime = std::chrono::high_resolution_clock::now();
 
     SDL_Window *window = renderer.get_window();
@@ -29,8 +51,9 @@ int main() {
     int fps = 60;
     float dt = (float)fps / mult;
 
-    std::deque<float> fpsHistory;
     const size_t maxFpsHistory = 30;
+    std::array<float, maxFpsHistory> fpsHistory{};
+    size_t fpsSamples = 0;
     float rollingAverageFps = 0.0f;
 
     bool running = true;
@@ -46,11 +69,25 @@ int main() {
         SDL_RenderClear(sdl_renderer);
 
         frameNum++;
+
+#ifdef COUNT_ALLOCATIONS
+        long allocationsBefore = allocation_count.load();
+#endif
         
         simulation.run(mult, dt, frameNum);
 
+        if (exporter) exporter->publish(frameNum, simulation);
+
         renderer.drawFrame(simulation.particles);
 
+#ifdef COUNT_ALLOCATIONS
+        long frameAllocations = allocation_count.load() - allocationsBefore;
+        if (frameNum > steady_state_frame && frameAllocations != 0) {
+            fprintf(stderr, "Frame %d made %ld heap allocations\n", frameNum, frameAllocations);
+            return 1;
+        }
+#endif
+
         SDL_RenderPresent(sdl_renderer);
 
         int spawnX = 100;
@@ -58,7 +95,7 @@ int main() {
 
         int num_spawners = fmin(100, frameNum / fps * 10 + 1);
 
-        if(frameNum < 1000 && frameNum % 2 == 0) {
+        if(frameNum < 1000 && frameNum % 2 == 0 && (int)simulation.particles.size() < max_particles) {
             for (int i=0; i<num_spawners; i++) {
                     
                 float vx = 0.1;
@@ -80,16 +117,14 @@ int main() {
         liveFps = 1.0 / std::chrono::duration_cast<std::chrono::duration<float>>(std::chrono::high_resolution_clock::now() - prevTime).count();
         prevTime = std::chrono::high_resolution_clock::now();
 
-        fpsHistory.push_back(liveFps);
-        if (fpsHistory.size() > maxFpsHistory) {
-            fpsHistory.pop_front();
-        }
+        fpsHistory[fpsSamples++ % maxFpsHistory] = liveFps;
 
+        size_t numFps = std::min(fpsSamples, maxFpsHistory);
         float sumFps = 0.0f;
-        for (const auto& fps : fpsHistory) {
-            sumFps += fps;
+        for (size_t i = 0; i < numFps; i++) {
+            sumFps += fpsHistory[i];
         }
-        rollingAverageFps = sumFps / fpsHistory.size();
+        rollingAverageFps = sumFps / numFps;
         renderer.fps = rollingAverageFps;
         
         printf("FPS: %.2f, num_particles: %d\n", rollingAverageFps, (int)simulation.particles.size());
@@ -14,7 +14,7 @@ void MetalCompute::init_metal() {
     createBuffers();
 }
 
-void MetalCompute::updateBuffers(std::vector<Particle> vec_particles, std::vector<int> vec_indices, std::vector<int> vec_offsets, Constants c) {
+void MetalCompute::updateBuffers(const ParticleVector &vec_particles, const std::vector<int> &vec_indices, const std::vector<int> &vec_offsets, const Constants &c) {
     num_particles = vec_particles.size();
     num_indices = vec_indices.size();
     num_offsets = vec_offsets.size();
@@ -58,7 +58,7 @@ void MetalCompute::updateBuffers(std::vector<Particle> vec_particles, std::vecto
     deltas->didModifyRange(NS::Range({0, sizeof(float) * num_particles * 3 }));
 }
 
-void MetalCompute::loadFromBuffers(std::vector<Particle> &vec_particles) {
+void MetalCompute::loadFromBuffers(ParticleVector &vec_particles) {
     assert(vec_particles.size() == num_particles);
 
     memcpy(vec_particles.data(), particles->contents(), sizeof(Particle) * num_particles);
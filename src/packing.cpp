@@ -0,0 +1,157 @@
+#include "../include/simulation.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+// Initial states generated in place. Both layouts fill the region from its
+// bottom edge, which is where gravity would have put the particles anyway.
+
+// Random close packing of equal disks is about 0.82. Random beds are placed a
+// little looser so a short relaxation clears most overlaps, gravity settles
+// the rest within a few frames.
+static const float random_packing_fraction = 0.7f;
+
+int Simulation::addPacking(const PackingConfig &config) {
+    float max_radius = config.radius + config.radius_spread;
+    float min_radius = config.radius - config.radius_spread;
+
+    if (min_radius <= 0.0f || 2.0f * max_radius > grid_size) {
+        throw std::runtime_error("Packing radii must be positive and fit the collision grid");
+    }
+
+    glm::vec2 lo = glm::max(config.min, glm::vec2(0.0f, 0.0f));
+    glm::vec2 hi = glm::min(config.max, glm::vec2((float)width, (float)height));
+    if (hi.x - lo.x < 2.0f * max_radius || hi.y - lo.y < 2.0f * max_radius) {
+        throw std::runtime_error("Packing region is smaller than one particle");
+    }
+
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<float> radii(min_radius, max_radius);
+    auto sample_radius = [&] { return config.radius_spread > 0.0f ? radii(rng) : config.radius; };
+
+    int first = particles.size();
+
+    if (config.layout == PackingLayout::Hexagonal) {
+        // Lattice sized for the largest radius, so no two particles overlap
+        float spacing = 2.0f * max_radius;
+        float row_height = spacing * std::sqrt(3.0f) / 2.0f;
+
+        int placed = 0;
+        for (int row = 0; placed < config.count; row++) {
+            float y = hi.y - max_radius - row * row_height;
+            if (y < lo.y + max_radius) break;
+
+            float x = lo.x + max_radius + (row % 2) * 0.5f * spacing;
+            for (; x <= hi.x - max_radius && placed < config.count; x += spacing, placed++) {
+                glm::vec3 pos(x, y, 0);
+                particles.push_back(Particle{pos, pos, glm::vec3{}, 1.0f, sample_radius()});
+            }
+        }
+
+        if (placed < config.count) {
+            particles.resize(first);
+            throw std::runtime_error("Packing region holds " + std::to_string(placed) + " of the " + std::to_string(config.count) + " particles requested");
+        }
+    } else {
+        std::vector<float> sampled(config.count);
+        double area = 0.0;
+        for (float &r : sampled) {
+            r = sample_radius();
+            area += M_PI * r * r;
+        }
+
+        // Only as tall as the bed needs to be at the placement density
+        float bed = area / (random_packing_fraction * (hi.x - lo.x));
+        if (bed > hi.y - lo.y) {
+            throw std::runtime_error("Packing region is too small for " + std::to_string(config.count) + " particles");
+        }
+        float top = hi.y - bed;
+
+        for (float r : sampled) {
+            std::uniform_real_distribution<float> xs(lo.x + r, hi.x - r);
+            std::uniform_real_distribution<float> ys(std::min(top + r, hi.y - r), hi.y - r);
+
+            glm::vec3 pos(xs(rng), ys(rng), 0);
+            particles.push_back(Particle{pos, pos, glm::vec3{}, 1.0f, r});
+        }
+    }
+
+    if (config.relax_iterations > 0) {
+        relaxOverlaps(config.relax_iterations);
+    } else {
+        update_grid();
+    }
+    return first;
+}
+
+// Jacobi passes over the grid: every particle moves itself by half of each
+// overlap from a frozen snapshot, and position_last moves by the same amount
+// so the relaxation adds no velocity
+float Simulation::relaxOverlaps(int iterations) {
+    int num_particles = particles.size();
+    collisionDeltas.resize(num_particles);
+    float max_overlap = 0.0f;
+
+    for (int it = 0; it <= iterations; it++) {
+        update_grid();
+
+        std::atomic<float> largest{0.0f};
+
+        threader.Parallel(num_particles, [&](int start, int end) {
+            float local = 0.0f;
+
+            for (int i=start; i<end; i++) {
+                const Particle& p1 = particles[i];
+                glm::vec2 delta{};
+
+                forEachNearby(p1.position, [&](int j) {
+                    if (j == i) return;
+
+                    const Particle& p2 = particles[j];
+                    float dx = p1.position.x - p2.position.x;
+                    float dy = p1.position.y - p2.position.y;
+                    float distSquared = dx * dx + dy * dy;
+                    float minDist = p1.radius + p2.radius;
+
+                    if (distSquared < minDist * minDist) {
+                        float dist = std::sqrt(distSquared);
+                        float push = 0.5f * (minDist - dist);
+                        local = std::max(local, minDist - dist);
+
+                        // Coincident particles separate along an arbitrary, index based axis
+                        if (dist < 1e-8f) {
+                            delta.x += i < j ? push : -push;
+                        } else {
+                            delta += glm::vec2(dx, dy) * (push / dist);
+                        }
+                    }
+                });
+                collisionDeltas[i] = delta;
+            }
+
+            float current = largest.load();
+            while (local > current && !largest.compare_exchange_weak(current, local)) {}
+        });
+
+        // The last pass only measures what is left
+        max_overlap = largest.load();
+        if (it == iterations || max_overlap == 0.0f) break;
+
+        threader.Parallel(num_particles, [&](int start, int end) {
+            for (int i=start; i<end; i++) {
+                Particle& p = particles[i];
+                glm::vec3 before = p.position;
+                p.position.x = std::clamp(p.position.x + collisionDeltas[i].x, p.radius, width - p.radius);
+                p.position.y = std::clamp(p.position.y + collisionDeltas[i].y, p.radius, height - p.radius);
+                p.position_last += p.position - before;
+            }
+        });
+    }
+
+    buildPositions.clear();
+    return max_overlap;
+}
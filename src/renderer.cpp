@@ -51,21 +51,22 @@ Renderer::~Renderer() {
     SDL_Quit();
 }
 
-void Renderer::drawFrame(std::vector<Particle> particles) {
+void Renderer::drawFrame(const ParticleVector &particles) {
     SDL_SetRenderDrawColor(sdl_renderer, 0, 0, 0, 255);
 
-    // Reserve space to avoid reallocations
-    std::vector<SDL_Rect> rects;
-    rects.reserve(particles.size());
-
-    for (const auto &p : particles) {
-        rects.emplace_back(SDL_Rect{
-            static_cast<int>(p.position.x - p.radius),
-            static_cast<int>(p.position.y - p.radius),
-            static_cast<int>(p.radius * 2),
-            static_cast<int>(p.radius * 2)
-        });
-    }
+    rects.resize(particles.size());
+
+    threader.Parallel(particles.size(), [&](int start, int end) {
+        for (int i = start; i < end; i++) {
+            const Particle &p = particles[i];
+            rects[i] = SDL_Rect{
+                static_cast<int>(p.position.x - p.radius),
+                static_cast<int>(p.position.y - p.radius),
+                static_cast<int>(p.radius * 2),
+                static_cast<int>(p.radius * 2)
+            };
+        }
+    });
 
     SDL_RenderFillRects(sdl_renderer, rects.data(), static_cast<int>(rects.size()));
 }
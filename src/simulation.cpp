@@ -2,13 +2,21 @@
 #include <chrono>
 #include <thread>
 #include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 #include "/Users/alois/Desktop/projects/CustomUtils/print.hpp"
 #include "../include/simulation.hpp"
 
 #define USE_SHADER true
 
-Simulation::Simulation(MetalCompute &metalHandler, int width, int height) : metalHandler(metalHandler) {
+Simulation::Simulation(MetalCompute &metalHandler, int width, int height) : Simulation(width, height) {
+    this->metalHandler = &metalHandler;
+}
+
+Simulation::Simulation(int width, int height) : metalHandler(nullptr) {
     setWindowSize(width, height);
     particles.push_back(Particle{
         glm::vec3(width/2, height/2, 0),   // position
@@ -27,6 +35,21 @@ int max(int a, int b) {
 }
 
 void Simulation::run(int num_iterations, float dt, int frameNum) {
+    frameArena.reset();
+    removeParticles(dt * num_iterations);
+
+    bool shader = USE_SHADER && metalHandler;
+    bool fused = use_fused && !shader;
+    bool xpbd = use_xpbd && !shader && !fused;
+    bool neighbourLists = use_neighbour_lists && !shader && !fused && !xpbd;
+
+    if (deterministic && shader) {
+        throw std::runtime_error("Deterministic mode needs the CPU path, the GPU collision pass is not reproducible");
+    }
+
+    // The default and GPU paths collide on the grid the previous frame left
+    if (gridStale && !fused && !xpbd && !neighbourLists) update_grid();
+
     Constants constants = {
         .num_particles = (int)particles.size(),
         .num_indices = (int)cellIndices.size(),
@@ -38,22 +61,70 @@ void Simulation::run(int num_iterations, float dt, int frameNum) {
         .grid_width = grid_width,
         .grid_height = grid_height
     };
+
+    // Room for this frame's checkpoints, so the substep loop never grows the log
+    if (hash_interval > 0) {
+        size_t needed = hashLog.size() + (step % hash_interval + num_iterations) / hash_interval;
+        if (needed > hashLog.capacity()) hashLog.reserve(std::max(needed, 2 * hashLog.capacity()));
+    }
      
     for (int i=0; i<num_iterations; i++) {
-        if(USE_SHADER) {
-            metalHandler.updateBuffers(particles, cellIndices, cellOffsets, constants);
-            metalHandler.update_particles();
-            metalHandler.handle_collisions();
-            metalHandler.handle_box_constraints();
-            metalHandler.loadFromBuffers(particles);
+        // Long-range forces read positions, the fused box pass has to land first
+        if (use_long_range) flushFusedBox();
+        applyLongRangeForces();
+
+        if(shader) {
+            metalHandler->updateBuffers(particles, cellIndices, cellOffsets, constants);
+            metalHandler->update_particles();
+            metalHandler->handle_collisions();
+            metalHandler->handle_box_constraints();
+            metalHandler->loadFromBuffers(particles);
+            solveLinks();
+            handleColliderCollisions();
+
+            // Links and colliders run after the GPU box pass and can push past a wall
+            if (!links.empty() || !colliders.empty()) boxConstraint();
+        } else if (fused) {
+            fusedSubstep(dt);
+        } else if (xpbd) {
+            xpbdSubstep(dt);
+        } else if (neighbourLists) {
+            updateParticles(dt);
+            // Checked after integration, so lists are never used once a
+            // particle has moved more than half the skin
+            if (needsNeighbourRebuild()) {
+                buildPositions.clear(); // Replaced below, cell_major need not remap them
+                update_grid();
+                buildNeighbourLists();
+            }
+            handleNeighbourListCollisions();
+            solveLinks();
+            handleColliderCollisions();
+            boxConstraint();
         } else {
             updateParticles(dt);
             handleCollisions();
+            solveLinks();
+            handleColliderCollisions();
             boxConstraint();
         }
 
-        update_grid();
+        // With neighbour lists the grid is only rebuilt alongside the lists,
+        // the fused and XPBD substeps build their own
+        if (!neighbourLists && !fused && !xpbd) update_grid();
+
+        step++;
+        if (hash_interval > 0 && step % hash_interval == 0) {
+            flushFusedBox();
+            hashLog.push_back(StateHash{step, hash_particles(particles, threader, frameArena)});
+        }
     }
+
+    flushFusedBox();
+
+    // Lists, XPBD and fused bin particles before their solves. Their grid is
+    // left as it is, queries rebuild it on demand.
+    gridStale = neighbourLists || xpbd || fused;
 }
 
 void Simulation::updateParticles(float dt) {
@@ -64,9 +135,35 @@ void Simulation::updateParticles(float dt) {
     }
 }
 
-void Simulation::handleGridCollisions(int x, int y) {
-    static float minDistSquared = pow((particles[0].radius * 2), 2);
+void Simulation::applyLongRangeForces() {
+    if (!use_long_range) return;
+
+    longRange.build(particles, threader);
+    longRange.accumulate(particles, threader);
+}
+
+// Pushes an overlapping pair apart, a quarter of the overlap each
+static inline void collide_pair(Particle& p1, Particle& p2) {
+    glm::vec3 v = p1.position - p2.position;
+    float distSquared = v.x * v.x + v.y * v.y;
+    float minDist = p1.radius + p2.radius;
+
+    if (distSquared < minDist * minDist) {
+        float dist = std::sqrt(distSquared);
+        if (dist < 1e-8f) dist = 1e-8f;
 
+        glm::vec3 n = v / dist;
+
+        float overlap = 0.25f * (minDist - dist);
+
+        if (overlap > 0.0f) {
+            p1.position += n * overlap;
+            p2.position -= n * overlap;
+        }
+    }
+}
+
+void Simulation::handleGridCollisions(int x, int y) {
     static std::vector<glm::vec2> toCheckOffsets = {
         {0, 0}, {1, 0}, {0, 1}, {1, 1}, {-1, 1} 
     };
@@ -76,7 +173,7 @@ void Simulation::handleGridCollisions(int x, int y) {
     int end   = cellOffsets[cellIndex + 1];
 
     for (int i = start; i < end; i++) {
-        int p1Index = cellIndices[i];
+        int p1Index = cell_major ? i : cellIndices[i];
         Particle& p1 = particles[p1Index];
 
         for (auto& offset : toCheckOffsets) {
@@ -92,49 +189,155 @@ void Simulation::handleGridCollisions(int x, int y) {
             int nEnd   = cellOffsets[neighborIndex + 1];
 
             for (int j = nStart; j < nEnd; j++) {
-                int p2Index = cellIndices[j];
+                // Cell-major storage: the neighbour cell is particles[nStart, nEnd)
+                int p2Index = cell_major ? j : cellIndices[j];
 
                 if (p1Index == p2Index) continue;
 
-                Particle& p2 = particles[p2Index];
-
-                glm::vec3 v = p1.position - p2.position;
-                float distSquared = v.x * v.x + v.y * v.y;
-
-                if (distSquared < minDistSquared) {
-                    float dist = std::sqrt(distSquared);
-                    if (dist < 1e-8f) dist = 1e-8f;
+                collide_pair(p1, particles[p2Index]);
+            }
+        }
+    }
+}
 
-                    glm::vec3 n = v / dist;
+void Simulation::handleCollisions() {
+    rowPrefix.resize(grid_height + 1);
+    for (int y=0; y<=grid_height; y++) {
+        rowPrefix[y] = cellOffsets[grid_index(0, y)];
+    }
 
-                    float overlap = 0.25f * ((p1.radius + p2.radius) - dist);
+    // Even boundaries keep the two row-parity passes free of overlapping writes
+    rowBalancer.split(rowPrefix.data(), grid_height, threader.size(), 2);
 
-                    if (overlap > 0.0f) {
-                        p1.position += n * overlap;
-                        p2.position -= n * overlap;
-                    }
+    threader.ParallelChunks(rowBalancer.bounds, [&](int chunk, int start, int end) {
+        timed_chunk(rowBalancer, chunk, [&] {
+            for (int i=start; i<end; i += 2) {
+                for (int j=0; j<grid_width; j++) {
+                    handleGridCollisions(j, i);
                 }
             }
+        });
+    });
+        
+    threader.ParallelChunks(rowBalancer.bounds, [&](int chunk, int start, int end) {
+        timed_chunk(rowBalancer, chunk, [&] {
+            for (int i=start; i<end && i+1<grid_height; i += 2) {
+                for (int j=0; j<grid_width; j++) {
+                    handleGridCollisions(j, i+1);
+                }
+            }
+        });
+    });
+
+    if (!deterministic) rowBalancer.update();
+}
+
+void Simulation::handleColliderCollisions() {
+    if (colliders.empty()) return;
+
+    if (colliders.dirty) {
+        // Colliders keep their own grid over the whole box
+        colliders.build(width / grid_size, grid_height, grid_size, grid_size * 0.5f);
+    }
+
+    threader.Parallel(particles.size(), [&](int start, int end) {
+        for (int i=start; i<end; i++) {
+            colliders.collide(particles[i], dampening);
+        }
+    });
+}
+
+void Simulation::solveLinks() {
+    if (links.empty()) return;
+
+    links.solve(particles, threader);
+}
+
+void Simulation::addLink(int a, int b, float stiffness) {
+    glm::vec3 v = particles[a].position - particles[b].position;
+    links.add(a, b, std::sqrt(v.x * v.x + v.y * v.y), stiffness);
+}
+
+int Simulation::addChain(glm::vec2 from, glm::vec2 to, int count, float radius, float stiffness) {
+    int first = particles.size();
+
+    for (int i=0; i<count; i++) {
+        float t = count > 1 ? (float)i / (count - 1) : 0.0f;
+        glm::vec3 pos = glm::vec3(from + (to - from) * t, 0);
+        particles.push_back(Particle{pos, pos, glm::vec3{}, 1.0f, radius});
+
+        if (i > 0) addLink(first + i - 1, first + i, stiffness);
+    }
+    return first;
+}
+
+int Simulation::addCloth(glm::vec2 origin, int cols, int rows, float spacing, float radius, float stiffness) {
+    int first = particles.size();
+
+    for (int y=0; y<rows; y++) {
+        for (int x=0; x<cols; x++) {
+            glm::vec3 pos = glm::vec3(origin.x + x * spacing, origin.y + y * spacing, 0);
+            particles.push_back(Particle{pos, pos, glm::vec3{}, 1.0f, radius});
+
+            int index = first + x + y * cols;
+            if (x > 0) addLink(index - 1, index, stiffness);
+            if (y > 0) addLink(index - cols, index, stiffness);
         }
     }
+    return first;
 }
 
-void Simulation::handleCollisions() {
-    threader.Parallel(grid_height, [&](int start, int end) {
-        for (int i=start; i<end; i += 2) {
-            for (int j=0; j<grid_width; j++) {
-                handleGridCollisions(j, i);
+int Simulation::addBlob(glm::vec2 center, int count, float blob_radius, float radius, float stiffness) {
+    int hub = particles.size();
+    glm::vec3 c = glm::vec3(center, 0);
+    particles.push_back(Particle{c, c, glm::vec3{}, 1.0f, radius});
+
+    for (int i=0; i<count; i++) {
+        float angle = 2.0f * M_PI * i / count;
+        glm::vec3 pos = c + glm::vec3(std::cos(angle), std::sin(angle), 0) * blob_radius;
+        particles.push_back(Particle{pos, pos, glm::vec3{}, 1.0f, radius});
+
+        int index = hub + 1 + i;
+        addLink(hub, index, stiffness);
+        if (i > 0) addLink(index - 1, index, 1.0f);
+    }
+    if (count > 2) addLink(hub + count, hub + 1, 1.0f);
+
+    return hub;
+}
+
+// Same pairs in the same order as handleCollisions, read from the lists
+// instead of the grid. Rows are those of the build, a particle's writes stay
+// within its build row and the next one, so the row parity passes still never
+// overlap however far particles moved since.
+void Simulation::handleNeighbourListCollisions() {
+    rowPrefix.resize(grid_height + 1);
+    for (int y=0; y<=grid_height; y++) {
+        rowPrefix[y] = neighbourOffsets[neighbourRows[y]];
+    }
+    contactBalancer.split(rowPrefix.data(), grid_height, threader.size(), 2);
+
+    auto collideRows = [&](int first, int end) {
+        for (int y=first; y<end; y += 2) {
+            for (int k = neighbourRows[y]; k < neighbourRows[y + 1]; k++) {
+                Particle& p1 = particles[neighbourOrder[k]];
+
+                for (int n = neighbourOffsets[k]; n < neighbourOffsets[k + 1]; n++) {
+                    collide_pair(p1, particles[neighbourIndices[n]]);
+                }
             }
         }
+    };
+
+    threader.ParallelChunks(contactBalancer.bounds, [&](int chunk, int start, int end) {
+        timed_chunk(contactBalancer, chunk, [&] { collideRows(start, end); });
     });
-        
-    threader.Parallel(grid_height, [&](int start, int end) {
-        for (int i=start; i<end; i += 2) {
-            for (int j=0; j<grid_width; j++) {
-                handleGridCollisions(j, i+1);
-            }
-        }
+
+    threader.ParallelChunks(contactBalancer.bounds, [&](int chunk, int start, int end) {
+        timed_chunk(contactBalancer, chunk, [&] { collideRows(start + 1, end); });
     });
+
+    if (!deterministic) contactBalancer.update();
 }
 
 void Simulation::handleCollisionsGeneral() {
@@ -186,30 +389,218 @@ void Simulation::circleConstraint() {
 
 void Simulation::boxConstraint() {
     for (int i = 0; i < (int)particles.size(); i++) {
-        Particle& p = particles[i];
+        constrainToBox(particles[i]);
+    }
+}
+
+void Simulation::constrainToBox(Particle& p) {
+    glm::vec3 vel = p.position - p.position_last;
+
+    if (p.position.x < p.radius) {
+        p.position.x = p.radius;
+        vel.x = -dampening * vel.x;  // Flip and dampen x-velocity
+    }
+    else if (p.position.x > width - p.radius) {
+        p.position.x = width - p.radius;
+        vel.x = -dampening * vel.x;
+    }
+
+    if (p.position.y < p.radius) {
+        p.position.y = p.radius;
+        vel.y = -dampening * vel.y;  // Flip and dampen y-velocity
+    }
+    else if (p.position.y > height - p.radius) {
+        p.position.y = height - p.radius;
+        vel.y = -dampening * vel.y;
+    }
+
+    set_particle_velocity(p, vel, 1.0f);
+}
+
+// One substep with a single streaming pass over the particles: each chunk
+// applies the previous substep's box, computes cell keys and counts them into
+// its own histogram, then integrates. That pass replaces updateParticles,
+// boxConstraint and both passes of update_grid. The grid is assembled from
+// the keys alone and collisions run the regular row parity passes over it,
+// so a fused substep gives the same result as a default one. The box of the
+// last substep stays pending until something reads positions.
+void Simulation::fusedSubstep(float dt) {
+    int num_particles = particles.size();
+    int cells = num_cells();
+    int num_chunks = threader.size();
+
+    fusedBounds.resize(num_chunks + 1);
+    for (int c=0; c<=num_chunks; c++) {
+        fusedBounds[c] = (int)((long long)num_particles * c / num_chunks);
+    }
+    cellKeys.resize(num_particles);
+    chunkHistograms.resize((size_t)num_chunks * cells);
+    cellOffsets.resize(cells + 1);
+    cellIndices.resize(num_particles);
 
-        glm::vec3 vel = p.position - p.position_last;
+    bool box = boxPending;
 
-        if (p.position.x < p.radius) {
-            p.position.x = p.radius;
-            vel.x = -dampening * vel.x;  // Flip and dampen x-velocity
+    threader.ParallelChunks(fusedBounds, [&](int chunk, int start, int end) {
+        int *histogram = chunkHistograms.data() + (size_t)chunk * cells;
+        memset(histogram, 0, sizeof(int) * cells);
+
+        for (int i=start; i<end; i++) {
+            Particle& p = particles[i];
+            if (box) constrainToBox(p);
+
+            // Binned before integration, like update_grid at the end of a default substep
+            int key = cell_key(p.position);
+            cellKeys[i] = key;
+            histogram[key]++;
+
+            accelerate_particle(p, {0, 0.000098, 0});
+            update_particle(p, dt);
         }
-        else if (p.position.x > width - p.radius) {
-            p.position.x = width - p.radius;
-            vel.x = -dampening * vel.x;
+    });
+
+    // Turn the histograms into per chunk write cursors: chunk k writes cell c
+    // after every earlier chunk's particles of that cell
+    threader.Parallel(cells, [&](int start, int end) {
+        for (int c=start; c<end; c++) {
+            int total = 0;
+            for (int k=0; k<num_chunks; k++) {
+                int count = chunkHistograms[(size_t)k * cells + c];
+                chunkHistograms[(size_t)k * cells + c] = total;
+                total += count;
+            }
+            cellOffsets[c + 1] = total;
         }
+    });
+
+    cellOffsets[0] = 0;
+    for (int c=1; c<=cells; c++) {
+        cellOffsets[c] += cellOffsets[c - 1];
+    }
+
+    threader.ParallelChunks(fusedBounds, [&](int chunk, int start, int end) {
+        int *cursor = chunkHistograms.data() + (size_t)chunk * cells;
 
-        if (p.position.y < p.radius) {
-            p.position.y = p.radius;
-            vel.y = -dampening * vel.y;  // Flip and dampen y-velocity
+        for (int i=start; i<end; i++) {
+            int key = cellKeys[i];
+            cellIndices[cellOffsets[key] + cursor[key]++] = i;
+        }
+    });
+
+    if (cell_major) sortByCell();
+
+    handleCollisions();
+    solveLinks();
+    handleColliderCollisions();
+
+    boxPending = true;
+}
+
+// Applies the fused substep's pending box pass, on the chunks it integrated
+void Simulation::flushFusedBox() {
+    if (!boxPending) return;
+
+    threader.ParallelChunks(fusedBounds, [&](int, int start, int end) {
+        for (int i=start; i<end; i++) {
+            constrainToBox(particles[i]);
         }
-        else if (p.position.y > height - p.radius) {
-            p.position.y = height - p.radius;
-            vel.y = -dampening * vel.y;
+    });
+    boxPending = false;
+}
+
+// Ages every particle, drops the ones that expired, entered a sink or left the
+// box, and hands out ids to new particles. Survivors keep their order: each
+// chunk counts what it keeps, then scatters into its slot of the prefix sum.
+void Simulation::removeParticles(float elapsed) {
+    int num_particles = particles.size();
+    int num_chunks = threader.size();
+
+    chunkBounds.resize(num_chunks + 1);
+    for (int c=0; c<=num_chunks; c++) {
+        chunkBounds[c] = (int)((long long)num_particles * c / num_chunks);
+    }
+    chunkKept.assign(num_chunks + 1, 0);
+    chunkNew.assign(num_chunks + 1, 0);
+    keep.resize(num_particles);
+
+    threader.ParallelChunks(chunkBounds, [&](int chunk, int start, int end) {
+        int kept = 0, fresh = 0;
+
+        for (int i=start; i<end; i++) {
+            Particle& p = particles[i];
+            p.age += elapsed;
+
+            bool alive = std::isfinite(p.position.x) && std::isfinite(p.position.y)
+                && p.position.x >= 0 && p.position.x < width
+                && p.position.y >= 0 && p.position.y < height
+                && (max_age <= 0.0f || p.age <= max_age);
+
+            for (const Sink& sink : sinks) {
+                if (p.position.x >= sink.min.x && p.position.x <= sink.max.x && p.position.y >= sink.min.y && p.position.y <= sink.max.y) {
+                    alive = false;
+                }
+            }
+
+            keep[i] = alive;
+            kept += alive;
+            fresh += alive && p.id < 0;
         }
+        chunkKept[chunk + 1] = kept;
+        chunkNew[chunk + 1] = fresh;
+    });
+
+    for (int c=1; c<=num_chunks; c++) {
+        chunkKept[c] += chunkKept[c - 1];
+        chunkNew[c] += chunkNew[c - 1];
+    }
+
+    int numKept = chunkKept[num_chunks];
+    int numNew = chunkNew[num_chunks];
+    if (numKept == num_particles && numNew == 0) return;
 
-        set_particle_velocity(p, vel, 1.0f);
+    bool removing = numKept < num_particles;
+    if (removing) {
+        compacted.resize(numKept);
+        remap.resize(num_particles);
     }
+
+    threader.ParallelChunks(chunkBounds, [&](int chunk, int start, int end) {
+        int writePos = chunkKept[chunk];
+        int id = next_id + chunkNew[chunk];
+
+        for (int i=start; i<end; i++) {
+            if (!keep[i]) {
+                if (removing) remap[i] = -1;
+                continue;
+            }
+
+            Particle& p = particles[i];
+            if (p.id < 0) p.id = id++;
+
+            if (removing) {
+                compacted[writePos] = p;
+                remap[i] = writePos++;
+            }
+        }
+    });
+
+    next_id += numNew;
+    if (!removing) return;
+
+    particles.swap(compacted);
+    removed_particles += num_particles - numKept;
+
+    if (!links.empty()) {
+        int kept = 0;
+        for (const Link& l : links.links) {
+            if (remap[l.a] < 0 || remap[l.b] < 0) continue;
+            links.links[kept++] = Link{remap[l.a], remap[l.b], l.rest_length, l.stiffness};
+        }
+        links.links.resize(kept);
+        links.dirty = true;
+    }
+
+    buildPositions.clear();
+    update_grid();
 }
 
 void Simulation::init_grid() {
@@ -220,15 +611,12 @@ void Simulation::init_grid() {
 }
 
 void Simulation::update_grid() {
-    std::vector<int> cellCounts(num_cells(), 0);
+    cellCounts.assign(num_cells(), 0);
 
     for (int i=0; i < (int)particles.size(); i++) {
-        Particle& p = particles[i];
-
-        int gx = (int)(p.position.x / grid_size);
-        int gy = (int)(p.position.y / grid_size);
-
-        int cellIndex = gx + gy * grid_width;
+        // Clamped: a particle pushed past a wall since the last box pass
+        // still lands in an edge cell, it is culled at the next frame
+        int cellIndex = cell_key(particles[i].position);
         cellCounts[cellIndex]++;
     }
 
@@ -242,11 +630,7 @@ void Simulation::update_grid() {
     memset(cellCounts.data(), 0, sizeof(int) * num_cells());
 
     for (int i = 0; i < (int)particles.size(); i++) {
-        Particle& p = particles[i];
-        int gx = (int)(p.position.x / grid_size);
-        int gy = (int)(p.position.y / grid_size);
-
-        int cellIndex = gx + gy * grid_width;
+        int cellIndex = cell_key(particles[i].position);
 
         int offset = cellOffsets[cellIndex];
         int writePos = offset + cellCounts[cellIndex];
@@ -254,12 +638,193 @@ void Simulation::update_grid() {
         cellIndices[writePos] = i;
         cellCounts[cellIndex]++;
     }
+
+    gridStale = false;
+    if (cell_major) sortByCell();
 }
 
+void Simulation::sortByCell() {
+    int num_particles = particles.size();
+    sorted.resize(num_particles);
+    remap.resize(num_particles);
+
+    // Within a cell the default storage visits particles in id order. Keep
+    // that order, so the Gauss-Seidel passes see the same pairs in the same
+    // order as without cell_major. Particles added since the last sort sit at
+    // the end without an id, they get theirs now, in the order removeParticles
+    // would have handed them out.
+    int unnamed = num_particles;
+    while (unnamed > 0 && particles[unnamed - 1].id < 0) unnamed--;
+    for (int i=unnamed; i<num_particles; i++) {
+        particles[i].id = next_id++;
+    }
+
+    threader.Parallel(num_cells(), [&](int start, int end) {
+        for (int c=start; c<end; c++) {
+            for (int k = cellOffsets[c] + 1; k < cellOffsets[c + 1]; k++) {
+                int index = cellIndices[k];
+                int id = particles[index].id;
+
+                int m = k;
+                for (; m > cellOffsets[c] && particles[cellIndices[m - 1]].id > id; m--) {
+                    cellIndices[m] = cellIndices[m - 1];
+                }
+                cellIndices[m] = index;
+            }
+        }
+    });
+
+    threader.Parallel(num_particles, [&](int start, int end) {
+        for (int k=start; k<end; k++) {
+            int i = cellIndices[k];
+            sorted[k] = particles[i];
+            remap[i] = k;
+            cellIndices[k] = k;
+        }
+    });
+    particles.swap(sorted);
+
+    // A relabelling keeps every link colour valid, no need to recolour
+    threader.Parallel(links.links.size(), [&](int start, int end) {
+        for (int l=start; l<end; l++) {
+            links.links[l].a = remap[links.links[l].a];
+            links.links[l].b = remap[links.links[l].b];
+        }
+    });
+
+    // Neighbour lists stay valid under a relabelling too
+    if (buildPositions.size() == (size_t)num_particles) {
+        sortedPositions.resize(num_particles);
+        threader.Parallel(num_particles, [&](int start, int end) {
+            for (int i=start; i<end; i++) {
+                sortedPositions[remap[i]] = buildPositions[i];
+            }
+        });
+        buildPositions.swap(sortedPositions);
+
+        threader.Parallel(neighbourOrder.size(), [&](int start, int end) {
+            for (int k=start; k<end; k++) {
+                neighbourOrder[k] = remap[neighbourOrder[k]];
+            }
+        });
+        threader.Parallel(neighbourIndices.size(), [&](int start, int end) {
+            for (int n=start; n<end; n++) {
+                neighbourIndices[n] = remap[neighbourIndices[n]];
+            }
+        });
+    }
+}
+
+bool Simulation::needsNeighbourRebuild() {
+    if (buildPositions.size() != particles.size()) return true;
+
+    float limit = 0.25f * skin * skin;
+    std::atomic<bool> moved{false};
+
+    threader.Parallel(particles.size(), [&](int start, int end) {
+        for (int i=start; i<end && !moved.load(std::memory_order_relaxed); i++) {
+            float dx = particles[i].position.x - buildPositions[i].x;
+            float dy = particles[i].position.y - buildPositions[i].y;
+
+            if (dx * dx + dy * dy > limit) moved.store(true, std::memory_order_relaxed);
+        }
+    });
+    return moved.load();
+}
+
+void Simulation::buildNeighbourLists() {
+    static const int forward[4][2] = {{1, 0}, {0, 1}, {1, 1}, {-1, 1}};
+
+    int num_particles = particles.size();
+    int num_slots = cellIndices.size();
+
+    neighbourOrder.assign(cellIndices.begin(), cellIndices.end());
+    neighbourRows.resize(grid_height + 1);
+    for (int y=0; y<=grid_height; y++) {
+        neighbourRows[y] = cellOffsets[grid_index(0, y)];
+    }
+    neighbourOffsets.resize(num_slots + 1);
+    buildPositions.resize(num_particles);
+
+    // Calls f(j) for every candidate j of slot k in cell (x, y), visiting the
+    // cells and particles in the order handleGridCollisions does
+    auto forEachCandidate = [&](int x, int y, int k, auto&& f) {
+        const Particle& p1 = particles[cellIndices[k]];
+
+        auto consider = [&](int m) {
+            const Particle& p2 = particles[cellIndices[m]];
+            float dx = p1.position.x - p2.position.x;
+            float dy = p1.position.y - p2.position.y;
+            float cutoff = p1.radius + p2.radius + skin;
+
+            if (dx * dx + dy * dy < cutoff * cutoff) f(cellIndices[m]);
+        };
+
+        int cellIndex = grid_index(x, y);
+        for (int m = cellOffsets[cellIndex]; m < cellOffsets[cellIndex + 1]; m++) {
+            if (m != k) consider(m);
+        }
+
+        for (const auto& offset : forward) {
+            int nx = x + offset[0];
+            int ny = y + offset[1];
+            if (nx < 0 || nx >= grid_width || ny >= grid_height) continue;
+
+            int neighbourIndex = grid_index(nx, ny);
+            for (int m = cellOffsets[neighbourIndex]; m < cellOffsets[neighbourIndex + 1]; m++) {
+                consider(m);
+            }
+        }
+    };
+
+    threader.Parallel(num_cells(), [&](int start, int end) {
+        for (int c=start; c<end; c++) {
+            for (int k = cellOffsets[c]; k < cellOffsets[c + 1]; k++) {
+                int count = 0;
+                forEachCandidate(c % grid_width, c / grid_width, k, [&](int) { count++; });
+                neighbourOffsets[k + 1] = count;
+            }
+        }
+    });
+
+    neighbourOffsets[0] = 0;
+    for (int k = 1; k <= num_slots; k++) {
+        neighbourOffsets[k] += neighbourOffsets[k - 1];
+    }
+    neighbourIndices.resize(neighbourOffsets[num_slots]);
+
+    threader.Parallel(num_cells(), [&](int start, int end) {
+        for (int c=start; c<end; c++) {
+            for (int k = cellOffsets[c]; k < cellOffsets[c + 1]; k++) {
+                int writePos = neighbourOffsets[k];
+                forEachCandidate(c % grid_width, c / grid_width, k, [&](int j) { neighbourIndices[writePos++] = j; });
+            }
+        }
+    });
+
+    threader.Parallel(num_particles, [&](int start, int end) {
+        for (int i=start; i<end; i++) {
+            buildPositions[i] = glm::vec2(particles[i].position.x, particles[i].position.y);
+        }
+    });
+
+    neighbour_rebuilds++;
+}
 
 void Simulation::setWindowSize(int width, int height) {
     this->width = width;
     this->height = height;
     this->grid_width = width / grid_size;
     this->grid_height = height / grid_size;
+    this->grid_x0 = 0;
+    colliders.dirty = true;
+}
+
+void Simulation::setGridColumns(float x_min, float x_max) {
+    int columns = width / grid_size;
+    int first = std::clamp((int)(x_min / grid_size), 0, columns - 1);
+    int last = std::clamp((int)std::ceil(x_max / grid_size), first + 1, columns);
+
+    grid_x0 = first;
+    grid_width = last - first;
 }
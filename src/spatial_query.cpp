@@ -0,0 +1,146 @@
+#include "../include/simulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Batched queries over the simulation grid. Every query of a batch runs in
+// parallel and writes only to its own slice of the caller's buffers.
+
+void Simulation::ensureGrid() {
+    if (gridStale || (int)cellIndices.size() != (int)particles.size()) update_grid();
+}
+
+template <class F>
+static inline void for_each_cell_in(Simulation &sim, glm::vec2 lo, glm::vec2 hi, F &&f) {
+    int x0 = std::max(0, (int)std::floor(lo.x / grid_size) - sim.grid_x0);
+    int y0 = std::max(0, (int)std::floor(lo.y / grid_size));
+    int x1 = std::min(sim.grid_width - 1, (int)std::floor(hi.x / grid_size) - sim.grid_x0);
+    int y1 = std::min(sim.grid_height - 1, (int)std::floor(hi.y / grid_size));
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            int cellIndex = sim.grid_index(x, y);
+            for (int k = sim.cellOffsets[cellIndex]; k < sim.cellOffsets[cellIndex + 1]; k++) {
+                f(sim.cellIndices[k]);
+            }
+        }
+    }
+}
+
+void Simulation::queryRadius(const RadiusQuery *queries, int num_queries, int *results, int capacity, int *counts) {
+    ensureGrid();
+
+    threader.Parallel(num_queries, [&](int start, int end) {
+        for (int q = start; q < end; q++) {
+            const RadiusQuery &query = queries[q];
+            glm::vec2 extent = glm::vec2(query.radius, query.radius);
+            float radiusSquared = query.radius * query.radius;
+
+            int *out = results + (size_t)q * capacity;
+            int count = 0;
+
+            for_each_cell_in(*this, query.center - extent, query.center + extent, [&](int i) {
+                float dx = particles[i].position.x - query.center.x;
+                float dy = particles[i].position.y - query.center.y;
+
+                if (dx * dx + dy * dy <= radiusSquared) {
+                    if (count < capacity) out[count] = i;
+                    count++;
+                }
+            });
+            counts[q] = count;
+        }
+    });
+}
+
+void Simulation::queryBox(const BoxQuery *queries, int num_queries, int *results, int capacity, int *counts) {
+    ensureGrid();
+
+    threader.Parallel(num_queries, [&](int start, int end) {
+        for (int q = start; q < end; q++) {
+            const BoxQuery &query = queries[q];
+
+            int *out = results ? results + (size_t)q * capacity : nullptr;
+            int count = 0;
+
+            for_each_cell_in(*this, query.min, query.max, [&](int i) {
+                const glm::vec3 &pos = particles[i].position;
+
+                if (pos.x >= query.min.x && pos.x <= query.max.x && pos.y >= query.min.y && pos.y <= query.max.y) {
+                    if (out && count < capacity) out[count] = i;
+                    count++;
+                }
+            });
+            counts[q] = count;
+        }
+    });
+}
+
+void Simulation::countInBox(const BoxQuery *queries, int num_queries, int *counts) {
+    queryBox(queries, num_queries, nullptr, 0, counts);
+}
+
+void Simulation::queryNearest(const glm::vec2 *points, int num_queries, int k, int *results, float *distances) {
+    ensureGrid();
+    if (k <= 0) return;
+
+    threader.Parallel(num_queries, [&](int start, int end) {
+        for (int q = start; q < end; q++) {
+            glm::vec2 point = points[q];
+            int *outIndices = results + (size_t)q * k;
+            float *outDistances = distances + (size_t)q * k;
+
+            // Sorted ascending by squared distance, kept in the caller's buffers
+            int found = 0;
+            auto insert = [&](int i, float distSquared) {
+                if (found == k && distSquared >= outDistances[k - 1]) return;
+
+                int pos = found < k ? found++ : k - 1;
+                while (pos > 0 && outDistances[pos - 1] > distSquared) {
+                    outDistances[pos] = outDistances[pos - 1];
+                    outIndices[pos] = outIndices[pos - 1];
+                    pos--;
+                }
+                outDistances[pos] = distSquared;
+                outIndices[pos] = i;
+            };
+
+            int cx = std::clamp((int)std::floor(point.x / grid_size) - grid_x0, 0, grid_width - 1);
+            int cy = std::clamp((int)std::floor(point.y / grid_size), 0, grid_height - 1);
+            int maxRing = std::max(grid_width, grid_height);
+
+            // Grow square rings of cells until nothing outside the ring can be closer
+            for (int ring = 0; ring <= maxRing; ring++) {
+                for (int y = cy - ring; y <= cy + ring; y++) {
+                    if (y < 0 || y >= grid_height) continue;
+
+                    bool edgeRow = y == cy - ring || y == cy + ring;
+                    for (int x = cx - ring; x <= cx + ring; x += edgeRow ? 1 : 2 * ring) {
+                        if (x >= 0 && x < grid_width) {
+                            int cellIndex = grid_index(x, y);
+                            for (int j = cellOffsets[cellIndex]; j < cellOffsets[cellIndex + 1]; j++) {
+                                int i = cellIndices[j];
+                                float dx = particles[i].position.x - point.x;
+                                float dy = particles[i].position.y - point.y;
+                                insert(i, dx * dx + dy * dy);
+                            }
+                        }
+                        if (ring == 0) break;
+                    }
+                }
+
+                float reach = (float)ring * grid_size;
+                if (found == k && outDistances[k - 1] <= reach * reach) break;
+            }
+
+            for (int j = 0; j < k; j++) {
+                if (j < found) {
+                    outDistances[j] = std::sqrt(outDistances[j]);
+                } else {
+                    outIndices[j] = -1;
+                    outDistances[j] = INFINITY;
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,123 @@
+#include "../include/state_export.hpp"
+#include "../include/simulation.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+// True while the segment is a complete one of ours and its writer still runs
+static bool segment_is_live(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    ExportHeader probe;
+    bool complete = pread(fd, &probe, sizeof(ExportHeader), 0) == sizeof(ExportHeader)
+        && probe.magic == state_export_magic && probe.version == state_export_version;
+    close(fd);
+
+    // Anything we cannot identify, an older layout or a writer still setting
+    // up, is treated as live and left alone
+    if (!complete) return true;
+    return probe.writer_pid > 0 && (kill(probe.writer_pid, 0) == 0 || errno == EPERM);
+}
+
+StateExporter::StateExporter(const std::string &name, int max_particles, int max_cells) : name(name) {
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+
+    if (fd < 0 && errno == EEXIST) {
+        if (segment_is_live(name)) {
+            throw std::runtime_error("Live state segment " + name + " is in use by another process");
+        }
+
+        // Left behind by a writer that did not exit cleanly
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create live state segment " + name + ": " + strerror(errno));
+    }
+
+    size_t slot_bytes = export_slot_bytes(max_particles, max_cells);
+    mapped_size = sizeof(ExportHeader) + slot_bytes * state_export_slots;
+
+    if (ftruncate(fd, mapped_size) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Failed to size live state segment " + name);
+    }
+
+    void *mem = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Failed to map live state segment " + name);
+    }
+
+    header = static_cast<ExportHeader *>(mem);
+    slots = static_cast<char *>(mem) + sizeof(ExportHeader);
+
+    header->max_particles = max_particles;
+    header->max_cells = max_cells;
+    header->slot_bytes = slot_bytes;
+    header->writer_pid = getpid();
+    new (&header->latest) std::atomic<int32_t>(-1);
+
+    for (int s = 0; s < state_export_slots; s++) {
+        new (&reinterpret_cast<ExportSlot *>(slots + s * slot_bytes)->sequence) std::atomic<uint64_t>(0);
+    }
+
+    // Readers check the magic last, so they never map a half initialised segment
+    header->version = state_export_version;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = state_export_magic;
+}
+
+StateExporter::~StateExporter() {
+    munmap(header, mapped_size);
+    shm_unlink(name.c_str());
+}
+
+void StateExporter::publish(uint64_t frame, Simulation &sim, bool density) {
+    int latest = header->latest.load(std::memory_order_relaxed);
+    int target = (latest + 1) % state_export_slots;
+
+    ExportSlot *slot = reinterpret_cast<ExportSlot *>(slots + (size_t)target * header->slot_bytes);
+    uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (density) sim.ensureGrid();
+
+    int num_particles = std::min((int)sim.particles.size(), (int)header->max_particles);
+    int num_cells = sim.num_cells();
+    bool withDensity = density && num_cells <= (int)header->max_cells && (int)sim.cellOffsets.size() == num_cells + 1;
+
+    slot->frame = frame;
+    slot->num_particles = num_particles;
+    slot->total_particles = sim.particles.size();
+    slot->grid_width = sim.grid_width;
+    slot->grid_height = sim.grid_height;
+    slot->has_density = withDensity;
+
+    float *positions = export_positions(slot);
+    int32_t *ids = export_ids(slot, header->max_particles);
+    sim.threader.Parallel(num_particles, [&](int start, int end) {
+        for (int i = start; i < end; i++) {
+            positions[2 * i] = sim.particles[i].position.x;
+            positions[2 * i + 1] = sim.particles[i].position.y;
+            ids[i] = sim.particles[i].id;
+        }
+    });
+
+    if (withDensity) {
+        int32_t *cells = export_density(slot, header->max_particles);
+        for (int c = 0; c < num_cells; c++) {
+            cells[c] = sim.cellOffsets[c + 1] - sim.cellOffsets[c];
+        }
+    }
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    header->latest.store(target, std::memory_order_release);
+}
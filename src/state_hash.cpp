@@ -0,0 +1,96 @@
+#include "../include/state_hash.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static const int hash_chunk_size = 4096;
+
+static inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t float_pair_bits(float a, float b) {
+    uint32_t ia, ib;
+    memcpy(&ia, &a, sizeof(float));
+    memcpy(&ib, &b, sizeof(float));
+    return ((uint64_t)ia << 32) | ib;
+}
+
+uint64_t hash_particles(const ParticleVector &particles, ThreadPool &threader, FrameArena &scratch) {
+    int num_particles = particles.size();
+    int num_chunks = (num_particles + hash_chunk_size - 1) / hash_chunk_size;
+
+    uint64_t *chunkHashes = scratch.alloc<uint64_t>(num_chunks);
+
+    // Every particle is hashed with its id and the results are summed, so
+    // neither storage order nor chunking changes the hash
+    threader.Parallel(num_chunks, [&](int start, int end) {
+        for (int c = start; c < end; c++) {
+            uint64_t sum = 0;
+            int last = std::min(num_particles, (c + 1) * hash_chunk_size);
+
+            for (int i = c * hash_chunk_size; i < last; i++) {
+                const Particle &p = particles[i];
+                uint64_t h = mix((uint64_t)(uint32_t)p.id + 1);
+                h = mix(h ^ float_pair_bits(p.position.x, p.position.y));
+                h = mix(h ^ float_pair_bits(p.position_last.x, p.position_last.y));
+                sum += h;
+            }
+            chunkHashes[c] = sum;
+        }
+    });
+
+    uint64_t sum = 0;
+    for (int c = 0; c < num_chunks; c++) {
+        sum += chunkHashes[c];
+    }
+    return mix(mix(num_particles) ^ sum);
+}
+
+int first_divergence(const std::vector<StateHash> &a, const std::vector<StateHash> &b) {
+    size_t i = 0, j = 0;
+
+    while (i < a.size() && j < b.size()) {
+        if (a[i].step < b[j].step) {
+            i++;
+        } else if (b[j].step < a[i].step) {
+            j++;
+        } else {
+            if (a[i].hash != b[j].hash) return a[i].step;
+            i++;
+            j++;
+        }
+    }
+    return -1;
+}
+
+void write_hash_log(const std::string &path, const std::vector<StateHash> &log) {
+    std::ofstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open hash log " + path);
+    }
+
+    for (const StateHash &entry : log) {
+        file << entry.step << " " << std::hex << entry.hash << std::dec << "\n";
+    }
+}
+
+std::vector<StateHash> read_hash_log(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open hash log " + path);
+    }
+
+    std::vector<StateHash> log;
+    StateHash entry;
+    while (file >> entry.step >> std::hex >> entry.hash >> std::dec) {
+        log.push_back(entry);
+    }
+    return log;
+}
@@ -0,0 +1,202 @@
+#include "../include/simulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Extended position based dynamics: after prediction, contacts are gathered
+// once from the grid and solved for xpbd_iterations Gauss-Seidel sweeps with
+// an accumulated multiplier each, which makes the result independent of the
+// iteration count for a given compliance. Restitution is applied afterwards
+// on velocities, so it no longer depends on how deep a contact went.
+//
+// Contacts are owned by the grid row of their first particle and only reach
+// into the next row, so the row parity passes of handleCollisions keep the
+// sweeps free of overlapping writes. Velocities here are displacements per
+// substep, as everywhere else in the simulation.
+
+static const glm::vec3 gravity = {0, 0.000098, 0};
+
+void Simulation::xpbdSubstep(float dt) {
+    float alphaTilde = contact_compliance / (dt * dt);
+
+    updateParticles(dt);
+    boxConstraint();
+
+    update_grid();
+    buildContacts();
+
+    links.resetLambdas();
+    for (int it = 0; it < xpbd_iterations; it++) {
+        solveContacts(alphaTilde);
+        if (!links.empty()) links.solveCompliant(particles, threader, link_compliance / (dt * dt));
+    }
+
+    handleColliderCollisions();
+    boxConstraint();
+    applyRestitution(dt);
+
+    if (!deterministic) rowBalancer.update();
+}
+
+void Simulation::buildContacts() {
+    static const int forward[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+
+    rowPrefix.resize(grid_height + 1);
+    for (int y=0; y<=grid_height; y++) {
+        rowPrefix[y] = cellOffsets[grid_index(0, y)];
+    }
+    rowBalancer.split(rowPrefix.data(), grid_height, threader.size(), 2);
+
+    // The balancer moves rows between chunks, so every chunk gets room for all
+    // of the previous build's contacts and never regrows once the count settles
+    size_t totalContacts = 0;
+    for (const auto &contacts : chunkContacts) totalContacts += contacts.size();
+    chunkContacts.resize(threader.size());
+    for (auto &contacts : chunkContacts) {
+        if (contacts.capacity() < totalContacts) contacts.reserve(totalContacts + totalContacts / 8);
+    }
+    contactRowBegin.resize(grid_height);
+    contactRowEnd.resize(grid_height);
+
+    threader.ParallelChunks(rowBalancer.bounds, [&](int chunk, int start, int end) {
+        timed_chunk(rowBalancer, chunk, [&] {
+            std::vector<Contact> &contacts = chunkContacts[chunk];
+            contacts.clear();
+
+            auto consider = [&](int a, int b) {
+                const Particle& p1 = particles[a];
+                const Particle& p2 = particles[b];
+                float dx = p1.position.x - p2.position.x;
+                float dy = p1.position.y - p2.position.y;
+                float reach = p1.radius + p2.radius + contact_margin;
+
+                if (dx * dx + dy * dy < reach * reach) {
+                    float dist = std::max(std::sqrt(dx * dx + dy * dy), 1e-8f);
+                    float vx = (p1.position.x - p1.position_last.x) - (p2.position.x - p2.position_last.x);
+                    float vy = (p1.position.y - p1.position_last.y) - (p2.position.y - p2.position_last.y);
+
+                    contacts.push_back(Contact{a, b, 0.0f, (vx * dx + vy * dy) / dist});
+                }
+            };
+
+            for (int y=start; y<end; y++) {
+                contactRowBegin[y] = contacts.size();
+
+                for (int x=0; x<grid_width; x++) {
+                    int cellIndex = grid_index(x, y);
+
+                    for (int k = cellOffsets[cellIndex]; k < cellOffsets[cellIndex + 1]; k++) {
+                        int a = cellIndices[k];
+
+                        for (int m = k + 1; m < cellOffsets[cellIndex + 1]; m++) {
+                            consider(a, cellIndices[m]);
+                        }
+
+                        for (const auto& offset : forward) {
+                            int nx = x + offset[0];
+                            int ny = y + offset[1];
+                            if (nx < 0 || nx >= grid_width || ny >= grid_height) continue;
+
+                            int neighbourIndex = grid_index(nx, ny);
+                            for (int m = cellOffsets[neighbourIndex]; m < cellOffsets[neighbourIndex + 1]; m++) {
+                                consider(a, cellIndices[m]);
+                            }
+                        }
+                    }
+                }
+                contactRowEnd[y] = contacts.size();
+            }
+        });
+    });
+}
+
+void Simulation::solveContacts(float alphaTilde) {
+    auto solveRows = [&](int chunk, int first, int end) {
+        std::vector<Contact> &contacts = chunkContacts[chunk];
+
+        for (int y=first; y<end; y += 2) {
+            for (int c = contactRowBegin[y]; c < contactRowEnd[y]; c++) {
+                Contact& contact = contacts[c];
+                Particle& p1 = particles[contact.a];
+                Particle& p2 = particles[contact.b];
+
+                float dx = p1.position.x - p2.position.x;
+                float dy = p1.position.y - p2.position.y;
+                float dist = std::sqrt(dx * dx + dy * dy);
+                if (dist < 1e-8f) continue;
+
+                // Inequality: only a penetrating contact may push, and the
+                // accumulated multiplier never pulls the particles together
+                float constraint = dist - (p1.radius + p2.radius);
+                if (constraint >= 0.0f && contact.lambda == 0.0f) continue;
+
+                float w1 = 1.0f / p1.mass;
+                float w2 = 1.0f / p2.mass;
+
+                float deltaLambda = (-constraint - alphaTilde * contact.lambda) / (w1 + w2 + alphaTilde);
+                deltaLambda = std::max(deltaLambda, -contact.lambda);
+                contact.lambda += deltaLambda;
+
+                glm::vec3 n = glm::vec3(dx, dy, 0) / dist;
+                p1.position += n * (w1 * deltaLambda);
+                p2.position -= n * (w2 * deltaLambda);
+            }
+        }
+    };
+
+    threader.ParallelChunks(rowBalancer.bounds, [&](int chunk, int start, int end) {
+        timed_chunk(rowBalancer, chunk, [&] { solveRows(chunk, start, end); });
+    });
+
+    threader.ParallelChunks(rowBalancer.bounds, [&](int chunk, int start, int end) {
+        timed_chunk(rowBalancer, chunk, [&] { solveRows(chunk, start + 1, end); });
+    });
+}
+
+void Simulation::applyRestitution(float dt) {
+    // Approach speeds below what gravity adds in two substeps come to rest
+    // instead of bouncing, otherwise resting stacks jitter
+    float restingSpeed = 2.0f * gravity.y * dt * dt;
+
+    auto restituteRows = [&](int chunk, int first, int end) {
+        std::vector<Contact> &contacts = chunkContacts[chunk];
+
+        for (int y=first; y<end; y += 2) {
+            for (int c = contactRowBegin[y]; c < contactRowEnd[y]; c++) {
+                const Contact& contact = contacts[c];
+                if (contact.lambda <= 0.0f) continue;
+
+                Particle& p1 = particles[contact.a];
+                Particle& p2 = particles[contact.b];
+
+                float dx = p1.position.x - p2.position.x;
+                float dy = p1.position.y - p2.position.y;
+                float dist = std::sqrt(dx * dx + dy * dy);
+                if (dist < 1e-8f) continue;
+
+                glm::vec3 n = glm::vec3(dx, dy, 0) / dist;
+                glm::vec3 relative = (p1.position - p1.position_last) - (p2.position - p2.position_last);
+                float normalVelocity = relative.x * n.x + relative.y * n.y;
+
+                float restitution = -contact.normal_velocity > restingSpeed ? dampening : 0.0f;
+                float target = std::max(-restitution * contact.normal_velocity, 0.0f);
+
+                float w1 = 1.0f / p1.mass;
+                float w2 = 1.0f / p2.mass;
+                float impulse = (target - normalVelocity) / (w1 + w2);
+
+                // Velocity lives in position - position_last
+                p1.position_last -= n * (w1 * impulse);
+                p2.position_last += n * (w2 * impulse);
+            }
+        }
+    };
+
+    threader.ParallelChunks(rowBalancer.bounds, [&](int chunk, int start, int end) {
+        restituteRows(chunk, start, end);
+    });
+
+    threader.ParallelChunks(rowBalancer.bounds, [&](int chunk, int start, int end) {
+        restituteRows(chunk, start + 1, end);
+    });
+}
@@ -0,0 +1,105 @@
+// Headless version of `make check_allocs`: runs every CPU solver mode, and the
+// default solver with each optional feature, on a settling bed and fails if
+// any frame after the warm-up touches the heap.
+// Build with `make alloc_check`, then ./alloc_check [particles] [warmup] [frames]
+
+#define NS_PRIVATE_IMPLEMENTATION
+#define CA_PRIVATE_IMPLEMENTATION
+#define MTL_PRIVATE_IMPLEMENTATION
+
+#include "../include/simulation.hpp"
+#include "../include/state_export.hpp"
+#include "../utils/alloc_counter.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <unistd.h>
+
+struct CheckMode {
+    const char *name;
+    void (*configure)(Simulation &sim);
+    bool publish = false; // Export every frame through a StateExporter
+};
+
+static const CheckMode modes[] = {
+    {"default",        [](Simulation &) {}},
+    {"deterministic",  [](Simulation &sim) { sim.deterministic = true; }},
+    {"neighbour-list", [](Simulation &sim) { sim.use_neighbour_lists = true; }},
+    {"fused",          [](Simulation &sim) { sim.use_fused = true; }},
+    {"xpbd",           [](Simulation &sim) { sim.use_xpbd = true; }},
+    {"cell-major",     [](Simulation &sim) { sim.cell_major = true; }},
+    {"links",          [](Simulation &sim) {
+        sim.addChain({100.0f, 100.0f}, {400.0f, 100.0f}, 60, 2.0f);
+        sim.addBlob({600.0f, 150.0f}, 200, 40.0f, 2.0f);
+    }},
+    {"colliders",      [](Simulation &sim) {
+        sim.colliders.addPolygon({{100.0f, 300.0f}, {400.0f, 380.0f}, {700.0f, 300.0f}}, false);
+    }},
+    {"long-range",     [](Simulation &sim) { sim.use_long_range = true; }},
+    {"hashing",        [](Simulation &sim) { sim.hash_interval = 5; }},
+    {"export",         [](Simulation &) {}, true},
+};
+
+static const int substeps = 10;
+static const float dt = 6.0f;
+
+int main(int argc, char **argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 20000;
+    int warmup = argc > 2 ? atoi(argv[2]) : 100;
+    int frames = argc > 3 ? atoi(argv[3]) : 200;
+
+    int failed = 0;
+    for (const CheckMode &mode : modes) {
+        Simulation sim(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+        sim.particles.clear();
+        mode.configure(sim);
+
+        PackingConfig packing;
+        packing.layout = PackingLayout::Random;
+        packing.count = count;
+        packing.min = {0.0f, 0.0f};
+        packing.max = {(float)DEFAULT_WIDTH, (float)DEFAULT_HEIGHT};
+        packing.radius = 2.0f;
+        packing.relax_iterations = 10;
+        sim.addPacking(packing);
+
+        // The log only grows between frames, give it room for the whole run
+        if (sim.hash_interval > 0) {
+            sim.hashLog.reserve((warmup + frames) * substeps / sim.hash_interval + 1);
+        }
+
+        std::unique_ptr<StateExporter> exporter;
+        if (mode.publish) {
+            std::string name = "/particles-alloc-check-" + std::to_string(getpid());
+            exporter = std::make_unique<StateExporter>(name, (int)sim.particles.size(), sim.num_cells());
+        }
+
+        for (int frame = 1; frame <= warmup; frame++) {
+            sim.run(substeps, dt, frame);
+            if (exporter) exporter->publish(frame, sim);
+        }
+
+        long worst = 0;
+        int worstFrame = 0;
+        for (int frame = warmup + 1; frame <= warmup + frames; frame++) {
+            long before = allocation_count.load();
+            sim.run(substeps, dt, frame);
+            if (exporter) exporter->publish(frame, sim);
+            long allocations = allocation_count.load() - before;
+
+            if (allocations > worst) {
+                worst = allocations;
+                worstFrame = frame;
+            }
+        }
+
+        if (worst != 0) {
+            printf("%-16s FAIL, frame %d made %ld heap allocations\n", mode.name, worstFrame, worst);
+            failed++;
+        } else {
+            printf("%-16s ok\n", mode.name);
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+// Compares the CPU solver modes on the same settling bed: time per frame
+// against how well the stack holds up. Every mode covers the same simulated
+// time per frame, split into its own number of substeps.
+// Build with `make bench` and run with `make run-bench`, or ./bench [particles] [frames]
+
+#define NS_PRIVATE_IMPLEMENTATION
+#define CA_PRIVATE_IMPLEMENTATION
+#define MTL_PRIVATE_IMPLEMENTATION
+
+#include "../include/simulation.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+struct BenchMode {
+    const char *name;
+    int substeps;
+    int iterations;
+    void (*configure)(Simulation &sim, int iterations);
+};
+
+static const float frame_time = 60.0f; // Same as main: dt = fps / mult per substep
+
+static const BenchMode modes[] = {
+    {"default",        10, 1, [](Simulation &, int) {}},
+    {"deterministic",  10, 1, [](Simulation &sim, int) { sim.deterministic = true; }},
+    {"neighbour-list", 10, 1, [](Simulation &sim, int) { sim.use_neighbour_lists = true; }},
+    {"fused",          10, 1, [](Simulation &sim, int) { sim.use_fused = true; }},
+    {"xpbd",            5, 2, [](Simulation &sim, int n) { sim.use_xpbd = true; sim.xpbd_iterations = n; }},
+    {"xpbd",            5, 4, [](Simulation &sim, int n) { sim.use_xpbd = true; sim.xpbd_iterations = n; }},
+    {"xpbd",            3, 4, [](Simulation &sim, int n) { sim.use_xpbd = true; sim.xpbd_iterations = n; }},
+};
+
+int main(int argc, char **argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 20000;
+    int frames = argc > 2 ? atoi(argv[2]) : 300;
+
+    printf("%d particles, %d frames, %d workers\n", count, frames, (int)executor().size());
+    printf("%-16s %8s %10s %10s %12s %12s %10s\n", "mode", "substeps", "iterations", "ms/frame", "max overlap", "mean speed", "bed top");
+
+    for (const BenchMode &mode : modes) {
+        Simulation sim(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+        sim.particles.clear();
+        mode.configure(sim, mode.iterations);
+
+        PackingConfig packing;
+        packing.layout = PackingLayout::Random;
+        packing.count = count;
+        packing.min = {0.0f, 0.0f};
+        packing.max = {(float)DEFAULT_WIDTH, (float)DEFAULT_HEIGHT};
+        packing.radius = 2.0f;
+        packing.relax_iterations = 10;
+        sim.addPacking(packing);
+
+        float dt = frame_time / mode.substeps;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 1; frame <= frames; frame++) {
+            sim.run(mode.substeps, dt, frame);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+        double speed = 0.0;
+        float top = DEFAULT_HEIGHT;
+        for (const Particle &p : sim.particles) {
+            float dx = p.position.x - p.position_last.x;
+            float dy = p.position.y - p.position_last.y;
+            speed += std::sqrt(dx * dx + dy * dy) / dt;
+            top = std::min(top, p.position.y);
+        }
+        speed /= std::max<size_t>(1, sim.particles.size());
+
+        float overlap = sim.relaxOverlaps(0); // Only measures
+        printf("%-16s %8d %10d %10.2f %12.3f %12.5f %10.1f\n", mode.name, mode.substeps, mode.iterations, ms, overlap, speed, top);
+    }
+    return 0;
+}
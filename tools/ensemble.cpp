@@ -0,0 +1,44 @@
+// Parameter sweep over dampening, dt and substeps in a single process, every
+// member on its own worker. Build with `make ensemble`, then
+// ./ensemble [results.csv] [frames]
+
+#define NS_PRIVATE_IMPLEMENTATION
+#define CA_PRIVATE_IMPLEMENTATION
+#define MTL_PRIVATE_IMPLEMENTATION
+
+#include "../include/ensemble.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "ensemble.csv";
+
+    EnsembleConfig config;
+    if (argc > 2) config.frames = atoi(argv[2]);
+
+    std::vector<EnsembleMember> members;
+    for (float dampening : {0.2f, 0.4f, 0.6f, 0.8f}) {
+        for (float dt : {3.0f, 6.0f}) {
+            for (int substeps : {5, 10}) {
+                for (int spawn_interval : {1, 2}) {
+                    EnsembleMember m;
+                    m.dampening = dampening;
+                    m.dt = dt;
+                    m.substeps = substeps;
+                    m.spawn_interval = spawn_interval;
+                    members.push_back(m);
+                }
+            }
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<EnsembleResult> results = run_ensemble(config, members);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    write_ensemble_csv(path, members, results);
+    printf("%d members on %d workers in %.2fs, results in %s\n", (int)members.size(), (int)executor().size(), seconds, path);
+    return 0;
+}
@@ -0,0 +1,39 @@
+// Reference consumer for the live state segment: prints a summary of the
+// latest frame a few times per second. Build with `make state_reader`.
+
+#include "../include/state_export.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+int main(int argc, char **argv) {
+    const char *name = argc > 1 ? argv[1] : "/particle_state";
+
+    StateReader reader(name);
+    StateFrame frame;
+    uint64_t lastFrame = ~0ull;
+
+    for (;;) {
+        if (reader.read(frame) && frame.frame != lastFrame) {
+            lastFrame = frame.frame;
+
+            int count = frame.positions.size() / 2;
+            double sumX = 0.0, sumY = 0.0;
+            for (int i = 0; i < count; i++) {
+                sumX += frame.positions[2 * i];
+                sumY += frame.positions[2 * i + 1];
+            }
+
+            int maxDensity = 0;
+            for (int d : frame.density) maxDensity = std::max(maxDensity, (int)d);
+
+            printf("frame %llu: %d particles (%d total), mean (%.1f, %.1f), max cell density %d\n",
+                (unsigned long long)frame.frame, count, frame.total_particles,
+                count ? sumX / count : 0.0, count ? sumY / count : 0.0, maxDensity);
+            fflush(stdout);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+}
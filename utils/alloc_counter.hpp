@@ -0,0 +1,29 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new so every heap allocation is counted. That
+// covers the containers, the FrameArena and the FirstTouchAllocator, which all
+// go through operator new. Replacements cannot be inline, so include this
+// from exactly one translation unit of a program.
+static std::atomic<long> allocation_count{0};
+
+void *operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t align) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    size_t alignment = static_cast<size_t>(align);
+    size = (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment;
+    if (void *p = aligned_alloc(alignment, size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
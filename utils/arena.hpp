@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for scratch arrays that only live until the next reset().
+// Requests that do not fit go to overflow blocks, and the next reset() folds
+// them into one block sized for the peak, so once the arena has seen a
+// typical frame it no longer touches the heap.
+class FrameArena {
+public:
+    explicit FrameArena(size_t initial_bytes = 1 << 16) : size(initial_bytes) {
+        if (size) block = static_cast<char *>(::operator new(size, std::align_val_t(alignment)));
+    }
+    ~FrameArena() {
+        release_overflow();
+        if (block) ::operator delete(block, std::align_val_t(alignment));
+    }
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    // Uninitialised storage for count objects of T
+    template <class T>
+    T *alloc(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "FrameArena never runs destructors");
+        static_assert(alignof(T) <= alignment, "FrameArena alignment too small");
+        if (count > (size_t)PTRDIFF_MAX / sizeof(T)) throw std::bad_array_new_length();
+        return static_cast<T *>(allocBytes(count * sizeof(T)));
+    }
+
+    void reset() {
+        if (!overflow.empty()) {
+            size_t peak = size + overflowBytes;
+            release_overflow();
+            if (block) ::operator delete(block, std::align_val_t(alignment));
+            block = static_cast<char *>(::operator new(peak, std::align_val_t(alignment)));
+            size = peak;
+        }
+        used = 0;
+    }
+
+    size_t capacity() const { return size; }
+
+private:
+    static constexpr size_t alignment = 64;
+
+    char *block = nullptr;
+    size_t size = 0;
+    size_t used = 0;
+
+    std::vector<void *> overflow;
+    size_t overflowBytes = 0;
+
+    void *allocBytes(size_t bytes) {
+        bytes = (bytes + alignment - 1) & ~(alignment - 1);
+
+        if (used + bytes <= size) {
+            void *p = block + used;
+            used += bytes;
+            return p;
+        }
+
+        void *p = ::operator new(bytes, std::align_val_t(alignment));
+        overflow.push_back(p);
+        overflowBytes += bytes;
+        return p;
+    }
+
+    void release_overflow() {
+        for (void *p : overflow) ::operator delete(p, std::align_val_t(alignment));
+        overflow.clear();
+        overflowBytes = 0;
+    }
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../include/config.hpp"
+#include "../utils/thread_pool.hpp"
+#include "../utils/topology.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include <unistd.h>
+
+// Process wide pool shared by the simulation and the renderer: one worker per
+// cpu the process may run on, pinned, ordered by NUMA node. A forked child gets a fresh pool, the
+// parent's workers do not exist there; the stale pool is leaked on purpose.
+inline ThreadPool &executor() {
+    static std::mutex mutex;
+    static ThreadPool *pool = nullptr;
+    static pid_t owner = 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pool || owner != getpid()) {
+        pool = new ThreadPool(Topology::discover().workerCpus(executor_skip_smt));
+        owner = getpid();
+    }
+    return *pool;
+}
+
+// Allocator that first touches new memory from the executor workers, using
+// the same chunking as ThreadPool::Parallel. Each page then lands on the node
+// of the worker that will later process those elements.
+template <class T>
+struct FirstTouchAllocator {
+    using value_type = T;
+
+    FirstTouchAllocator() = default;
+    template <class U>
+    FirstTouchAllocator(const FirstTouchAllocator<U>&) {}
+
+    static constexpr size_t page_size = 4096;
+
+    T *allocate(size_t n) {
+        if (n > (PTRDIFF_MAX - page_size) / sizeof(T)) throw std::bad_alloc();
+
+        size_t bytes = (n * sizeof(T) + page_size - 1) / page_size * page_size;
+
+        // Through operator new like everything else, so allocation counting sees it
+        void *ptr = ::operator new(bytes, std::align_val_t(page_size));
+
+        if (bytes >= (size_t)first_touch_min_bytes) {
+            char *mem = static_cast<char *>(ptr);
+            executor().Parallel(n, [&](int start, int end) {
+                memset(mem + start * sizeof(T), 0, (end - start) * sizeof(T));
+            });
+        }
+        return static_cast<T *>(ptr);
+    }
+
+    void deallocate(T *ptr, size_t) {
+        ::operator delete(ptr, std::align_val_t(page_size));
+    }
+
+    template <class U>
+    bool operator==(const FirstTouchAllocator<U>&) const { return true; }
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// Splits [0, n) into contiguous chunks of equal estimated cost. The work of an
+// item is its share of a prefix sum (e.g. particles per grid row), scaled by a
+// per item cost learned from the chunk timings of the previous call.
+class LoadBalancer {
+public:
+    std::vector<int> bounds; // num_chunks + 1 entries
+
+    // prefix has n + 1 entries. Chunk boundaries are multiples of granularity.
+    void split(const int *prefix, int n, int num_chunks, int granularity = 1) {
+        if ((int)itemCost.size() != n) itemCost.assign(n, 1.0);
+
+        weights.resize(n);
+        double total = 0.0;
+        for (int i = 0; i < n; i++) {
+            // Empty items still cost a little, the loop over them is not free
+            weights[i] = (prefix[i + 1] - prefix[i] + 0.05) * itemCost[i];
+            total += weights[i];
+        }
+
+        bounds.assign(num_chunks + 1, n);
+        bounds[0] = 0;
+
+        // Walk the allowed boundaries and cut at whichever side of each target is closer
+        double target = total / num_chunks;
+        double cumulative = 0.0;
+        double previous = 0.0;
+        int previousBoundary = 0;
+        int chunk = 1;
+
+        for (int i = 0; i < n && chunk < num_chunks; i++) {
+            cumulative += weights[i];
+
+            int next = i + 1;
+            if (next % granularity != 0 && next != n) continue;
+
+            while (chunk < num_chunks && cumulative >= target * chunk) {
+                bool takePrevious = target * chunk - previous < cumulative - target * chunk && previousBoundary > bounds[chunk - 1];
+                bounds[chunk] = takePrevious ? previousBoundary : next;
+                chunk++;
+            }
+
+            previous = cumulative;
+            previousBoundary = next;
+        }
+
+        chunkSeconds.assign(num_chunks, 0.0);
+        chunkWork.assign(num_chunks, 0.0);
+        for (int c = 0; c < num_chunks; c++) {
+            chunkWork[c] = prefix[bounds[c + 1]] - prefix[bounds[c]] + 0.05 * (bounds[c + 1] - bounds[c]);
+        }
+    }
+
+    // Accumulates time spent on a chunk, may be called from its worker
+    void record(int chunk, double seconds) {
+        chunkSeconds[chunk] += seconds;
+    }
+
+    // Folds the recorded timings into the per item cost estimate
+    void update() {
+        for (int c = 0; c + 1 < (int)bounds.size(); c++) {
+            int start = bounds[c];
+            int end = bounds[c + 1];
+            if (start >= end) continue;
+
+            double rate = chunkSeconds[c] / chunkWork[c];
+
+            for (int i = start; i < end; i++) {
+                itemCost[i] = 0.5 * itemCost[i] + 0.5 * rate;
+            }
+        }
+        normalise();
+    }
+
+private:
+    std::vector<double> itemCost;
+    std::vector<double> weights;
+    std::vector<double> chunkSeconds;
+    std::vector<double> chunkWork;
+
+    void normalise() {
+        double sum = 0.0;
+        for (double c : itemCost) sum += c;
+        if (sum <= 0.0) return;
+
+        double scale = itemCost.size() / sum;
+        for (double &c : itemCost) c *= scale;
+    }
+};
+
+// Runs f and reports its wall time to the balancer under the given chunk
+template <class F>
+inline void timed_chunk(LoadBalancer &balancer, int chunk, F &&f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    balancer.record(chunk, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
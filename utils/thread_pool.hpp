@@ -7,24 +7,67 @@
 #include <condition_variable>
 #include <functional>
 #include <future>
+#include <memory>
+#include <type_traits>
+
+#include "../utils/topology.hpp"
 
 class ThreadPool {
 public:
     ThreadPool(size_t numThreads);
+    ThreadPool(const std::vector<int> &cpus); // One worker pinned to each cpu
     ~ThreadPool();
 
     template <class F, class... Args>
     auto enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result<F, Args...>::type>;
 
-    void Parallel(int num_obj, std::function<void(int start, int end)>&& callback);
+    // Chunk i always runs on worker i, so memory first touched by a Parallel
+    // pass stays local to the worker that processes the same range later.
+    // Nested calls from inside a worker run inline. The callback is called
+    // through a plain pointer and the pool does not allocate, so both calls
+    // are safe in the per-frame loop. Callbacks must not throw.
+    template <class F>
+    void Parallel(int num_obj, F&& callback);
+
+    // Same as Parallel with caller chosen boundaries, bounds[i]..bounds[i + 1] runs on worker i % size()
+    template <class F>
+    void ParallelChunks(const std::vector<int> &bounds, F&& callback);
+
+    size_t size() const { return workers.size(); }
+    const std::vector<int> &pinnedCpus() const { return cpus; }
 
 private:
     std::vector<std::thread> workers;
+    std::vector<int> cpus;
+
     std::queue<std::function<void()>> tasks;
 
     std::mutex queueMutex;
     std::condition_variable condition;
     bool stop;
+
+    // One bulk job at a time is published to every worker through these
+    // fields, guarded by queueMutex. bounds == nullptr means equal chunks.
+    struct BulkJob {
+        void (*invoke)(void *context, int chunk, int start, int end) = nullptr;
+        void *context = nullptr;
+        const int *bounds = nullptr;
+        int num_obj = 0;
+        int num_chunks = 0;
+        int chunk_size = 0;
+    };
+    BulkJob bulk;
+    unsigned long bulkGeneration = 0;
+    int bulkRemaining = 0;
+    std::mutex bulkMutex; // Serialises callers from different threads
+    std::condition_variable bulkDone;
+
+    void runBulk(const BulkJob &job);
+    static void runChunks(const BulkJob &job, size_t worker, size_t num_workers);
+
+    static inline thread_local ThreadPool *current = nullptr;
+
+    void start(size_t numThreads);
 };
 
 inline ThreadPool::~ThreadPool() {
@@ -41,17 +84,52 @@ inline ThreadPool::~ThreadPool() {
 }
 
 inline ThreadPool::ThreadPool(size_t numThreads) : stop(false) {
+    start(numThreads);
+}
+
+inline ThreadPool::ThreadPool(const std::vector<int> &cpus) : cpus(cpus), stop(false) {
+    start(std::max<size_t>(1, cpus.size()));
+}
+
+inline void ThreadPool::start(size_t numThreads) {
     for (size_t i = 0; i < numThreads; ++i) {
-        workers.emplace_back([this] {
+        workers.emplace_back([this, i] {
+            current = this;
+            if (i < this->cpus.size()) restrict_to_cpus({this->cpus[i]});
+
+            unsigned long seen = 0;
+
             for (;;) {
                 std::function<void()> task;
+                BulkJob job;
+                bool isBulk = false;
 
                 {
                     std::unique_lock<std::mutex> lock(this->queueMutex);
-                    this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
-                    if (this->stop && this->tasks.empty()) return;
-                    task = std::move(this->tasks.front());
-                    this->tasks.pop();
+                    this->condition.wait(lock, [this, &seen] {
+                        return this->stop || seen != this->bulkGeneration || !this->tasks.empty();
+                    });
+
+                    if (seen != this->bulkGeneration) {
+                        seen = this->bulkGeneration;
+                        job = this->bulk;
+                        isBulk = true;
+                    } else {
+                        if (this->stop && this->tasks.empty()) return;
+
+                        task = std::move(this->tasks.front());
+                        this->tasks.pop();
+                    }
+                }
+
+                if (isBulk) {
+                    if ((int)i >= job.num_chunks) continue; // Nothing for this worker, not counted
+
+                    runChunks(job, i, this->workers.size());
+
+                    std::lock_guard<std::mutex> lock(this->queueMutex);
+                    if (--this->bulkRemaining == 0) this->bulkDone.notify_all();
+                    continue;
                 }
                 task();
             }
@@ -77,24 +155,71 @@ auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::inv
     return result;
 }
 
-inline void ThreadPool::Parallel(int num_obj, std::function<void(int start, int end)>&& callback) {
-    int num_threads = workers.size();
-    int chunk_size = (num_obj + num_threads - 1) / num_threads; // Divide workload evenly
+inline void ThreadPool::runChunks(const BulkJob &job, size_t worker, size_t num_workers) {
+    for (int chunk = (int)worker; chunk < job.num_chunks; chunk += (int)num_workers) {
+        int start, end;
+        if (job.bounds) {
+            start = job.bounds[chunk];
+            end = job.bounds[chunk + 1];
+        } else {
+            start = chunk * job.chunk_size;
+            end = std::min(start + job.chunk_size, job.num_obj);
+        }
+        if (start < end) job.invoke(job.context, chunk, start, end);
+    }
+}
 
-    std::vector<std::future<void>> futures;
+inline void ThreadPool::runBulk(const BulkJob &job) {
+    std::lock_guard<std::mutex> serial(bulkMutex);
 
-    for (int i = 0; i < num_threads; ++i) {
-        int start = i * chunk_size;
-        int end = std::min(start + chunk_size, num_obj);
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        bulk = job;
+        bulkGeneration++;
+        bulkRemaining = (int)std::min<size_t>(job.num_chunks, workers.size());
+    }
+    condition.notify_all();
 
-        if (start >= num_obj) break; // Stop if there are no more objects to process
+    std::unique_lock<std::mutex> lock(queueMutex);
+    bulkDone.wait(lock, [this] { return bulkRemaining == 0; });
+}
 
-        futures.emplace_back(enqueue([callback, start, end]() {
-            callback(start, end); // Invoke the callback for this chunk
-        }));
+template <class F>
+void ThreadPool::Parallel(int num_obj, F&& callback) {
+    if (num_obj <= 0) return;
+
+    if (current == this) {
+        callback(0, num_obj);
+        return;
     }
 
-    for (auto& future : futures) {
-        future.get();
+    using Callback = std::remove_reference_t<F>;
+
+    BulkJob job;
+    job.invoke = [](void *context, int, int start, int end) { (*static_cast<Callback *>(context))(start, end); };
+    job.context = const_cast<void *>(static_cast<const void *>(std::addressof(callback)));
+    job.num_obj = num_obj;
+    job.chunk_size = (num_obj + (int)workers.size() - 1) / (int)workers.size(); // Divide workload evenly
+    job.num_chunks = (num_obj + job.chunk_size - 1) / job.chunk_size;
+    runBulk(job);
+}
+
+template <class F>
+void ThreadPool::ParallelChunks(const std::vector<int> &bounds, F&& callback) {
+    int num_chunks = (int)bounds.size() - 1;
+    if (num_chunks <= 0) return;
+
+    if (current == this) {
+        for (int i = 0; i < num_chunks; ++i) callback(i, bounds[i], bounds[i + 1]);
+        return;
     }
+
+    using Callback = std::remove_reference_t<F>;
+
+    BulkJob job;
+    job.invoke = [](void *context, int chunk, int start, int end) { (*static_cast<Callback *>(context))(chunk, start, end); };
+    job.context = const_cast<void *>(static_cast<const void *>(std::addressof(callback)));
+    job.bounds = bounds.data();
+    job.num_chunks = num_chunks;
+    runBulk(job);
 }
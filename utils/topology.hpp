@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+struct CpuInfo {
+    int cpu;
+    int core;
+    int package;
+    int node;
+};
+
+// CPU and NUMA layout of the machine. On Linux it is read from sysfs and
+// limited to the cpus the process may run on (taskset, cpusets, containers),
+// elsewhere every hardware thread is reported as its own core on node 0.
+struct Topology {
+    std::vector<CpuInfo> cpus;
+    int num_nodes = 1;
+
+    static Topology discover();
+
+    // One cpu per worker, grouped by node so consecutive workers share memory.
+    // With skip_smt only the first hardware thread of every core is kept.
+    std::vector<int> workerCpus(bool skip_smt) const;
+
+    int nodeOf(int cpu) const;
+};
+
+inline std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> result;
+    std::stringstream ss(list);
+    std::string range;
+
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+        for (int cpu = first; cpu <= last; cpu++) result.push_back(cpu);
+    }
+    return result;
+}
+
+inline bool read_sysfs(const std::string &path, std::string &out) {
+    std::ifstream file(path);
+    if (!file) return false;
+    std::getline(file, out);
+    return true;
+}
+
+// Cpus in the affinity mask of the calling thread, empty when unknown
+inline std::vector<int> allowed_cpus() {
+    std::vector<int> result;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) result.push_back(cpu);
+        }
+    }
+#endif
+    return result;
+}
+
+// Restricts the calling thread to `cpus`. Threads it starts afterwards inherit
+// the mask, and so does a later discover(). Also pins ThreadPool workers.
+inline void restrict_to_cpus(const std::vector<int> &cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(cpu_set_t), &set);
+#else
+    (void)cpus; // No hard affinity on macOS, the scheduler places threads itself
+#endif
+}
+
+inline Topology Topology::discover() {
+    Topology topology;
+
+#ifdef __linux__
+    std::vector<int> allowed = allowed_cpus();
+    auto is_allowed = [&](int cpu) {
+        return allowed.empty() || std::find(allowed.begin(), allowed.end(), cpu) != allowed.end();
+    };
+
+    std::string online;
+    if (read_sysfs("/sys/devices/system/cpu/online", online)) {
+        for (int cpu : parse_cpu_list(online)) {
+            if (!is_allowed(cpu)) continue;
+
+            std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            std::string value;
+
+            CpuInfo info = {cpu, cpu, 0, 0};
+            if (read_sysfs(base + "core_id", value)) info.core = std::stoi(value);
+            if (read_sysfs(base + "physical_package_id", value)) info.package = std::stoi(value);
+            topology.cpus.push_back(info);
+        }
+
+        std::string nodes;
+        if (read_sysfs("/sys/devices/system/node/online", nodes)) {
+            std::vector<int> nodeIds = parse_cpu_list(nodes);
+            topology.num_nodes = nodeIds.empty() ? 1 : *std::max_element(nodeIds.begin(), nodeIds.end()) + 1;
+
+            for (int node : nodeIds) {
+                std::string cpulist;
+                if (!read_sysfs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", cpulist)) continue;
+
+                for (int cpu : parse_cpu_list(cpulist)) {
+                    for (CpuInfo &info : topology.cpus) {
+                        if (info.cpu == cpu) info.node = node;
+                    }
+                }
+            }
+        }
+    }
+#endif
+
+    if (topology.cpus.empty()) {
+        for (int cpu : allowed_cpus()) {
+            topology.cpus.push_back(CpuInfo{cpu, cpu, 0, 0});
+        }
+    }
+
+    if (topology.cpus.empty()) {
+        int count = std::max(1u, std::thread::hardware_concurrency());
+        for (int cpu = 0; cpu < count; cpu++) {
+            topology.cpus.push_back(CpuInfo{cpu, cpu, 0, 0});
+        }
+    }
+
+    return topology;
+}
+
+inline std::vector<int> Topology::workerCpus(bool skip_smt) const {
+    std::vector<CpuInfo> sorted = cpus;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const CpuInfo &a, const CpuInfo &b) {
+        return a.node < b.node;
+    });
+
+    std::vector<int> result;
+    std::set<std::pair<int, int>> seenCores;
+
+    for (const CpuInfo &info : sorted) {
+        if (skip_smt && !seenCores.insert({info.package, info.core}).second) continue;
+        result.push_back(info.cpu);
+    }
+    return result;
+}
+
+inline int Topology::nodeOf(int cpu) const {
+    for (const CpuInfo &info : cpus) {
+        if (info.cpu == cpu) return info.node;
+    }
+    return 0;
+}